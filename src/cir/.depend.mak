@@ -9,7 +9,7 @@ cirFraig.o: cirFraig.cpp cirMgr.h ../../include/util.h \
  ../../include/myHashMap.h cirGate.h ../../include/sat.h \
  ../../include/Solver.h ../../include/SolverTypes.h \
  ../../include/Global.h ../../include/VarOrder.h ../../include/Heap.h \
- ../../include/Proof.h ../../include/File.h
+ ../../include/Proof.h ../../include/File.h ../../include/myThreadPool.h
 cirGate.o: cirGate.cpp cirGate.h cirDef.h ../../include/myHashMap.h \
  ../../include/sat.h ../../include/Solver.h ../../include/SolverTypes.h \
  ../../include/Global.h ../../include/VarOrder.h ../../include/Heap.h \
@@ -19,7 +19,7 @@ cirMgr.o: cirMgr.cpp cirMgr.h ../../include/util.h ../../include/rnGen.h \
  ../../include/myUsage.h cirDef.h ../../include/myHashMap.h cirGate.h \
  ../../include/sat.h ../../include/Solver.h ../../include/SolverTypes.h \
  ../../include/Global.h ../../include/VarOrder.h ../../include/Heap.h \
- ../../include/Proof.h ../../include/File.h
+ ../../include/Proof.h ../../include/File.h ../../include/myThreadPool.h
 cirOpt.o: cirOpt.cpp cirMgr.h ../../include/util.h ../../include/rnGen.h \
  ../../include/myUsage.h cirDef.h ../../include/myHashMap.h cirGate.h \
  ../../include/sat.h ../../include/Solver.h ../../include/SolverTypes.h \
@@ -29,4 +29,4 @@ cirSim.o: cirSim.cpp cirMgr.h ../../include/util.h ../../include/rnGen.h \
  ../../include/myUsage.h cirDef.h ../../include/myHashMap.h cirGate.h \
  ../../include/sat.h ../../include/Solver.h ../../include/SolverTypes.h \
  ../../include/Global.h ../../include/VarOrder.h ../../include/Heap.h \
- ../../include/Proof.h ../../include/File.h
+ ../../include/Proof.h ../../include/File.h ../../include/myThreadPool.h
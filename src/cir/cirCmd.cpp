@@ -9,6 +9,8 @@
 #include <cassert>
 #include <iostream>
 #include <iomanip>
+#include <fcntl.h>
+#include <unistd.h>
 #include "cirMgr.h"
 #include "cirGate.h"
 #include "cirCmd.h"
@@ -17,7 +19,6 @@
 using namespace std;
 
 extern CirMgr* cirMgr;
-extern int effLimit;
 
 bool
 initCirCmd()
@@ -27,6 +28,7 @@ initCirCmd()
          cmdMgr->regCmd("CIRGate", 4, new CirGateCmd) &&
          cmdMgr->regCmd("CIRSWeep", 5, new CirSweepCmd) &&
          cmdMgr->regCmd("CIROPTimize", 6, new CirOptCmd) &&
+         cmdMgr->regCmd("CIRCompact", 4, new CirCompactCmd) &&
          cmdMgr->regCmd("CIRSTRash", 6, new CirStrashCmd) &&
          cmdMgr->regCmd("CIRSIMulate", 6, new CirSimCmd) &&
          cmdMgr->regCmd("CIRFraig", 4, new CirFraigCmd) &&
@@ -54,7 +56,7 @@ enum CirCmdState
 static CirCmdState curCmd = CIRINIT;
 
 //----------------------------------------------------------------------
-//    CIRRead <(string fileName)> [-Replace]
+//    CIRRead <(string fileName)> [-Replace] [-Threads (int n)]
 //----------------------------------------------------------------------
 CmdExecStatus
 CirReadCmd::exec(const string& option)
@@ -67,12 +69,21 @@ CirReadCmd::exec(const string& option)
       return CmdExec::errorOption(CMD_OPT_MISSING, "");
 
    bool doReplace = false;
+   int nThreads = 0;
    string fileName;
    for (size_t i = 0, n = options.size(); i < n; ++i) {
       if (myStrNCmp("-Replace", options[i], 2) == 0) {
          if (doReplace) return CmdExec::errorOption(CMD_OPT_EXTRA,options[i]);
          doReplace = true;
       }
+      else if (myStrNCmp("-Threads", options[i], 2) == 0) {
+         if (nThreads)
+            return CmdExec::errorOption(CMD_OPT_EXTRA, options[i]);
+         if (++i == n)
+            return CmdExec::errorOption(CMD_OPT_MISSING, options[i-1]);
+         if (!myStr2Int(options[i], nThreads) || nThreads <= 0)
+            return CmdExec::errorOption(CMD_OPT_ILLEGAL, options[i]);
+      }
       else {
          if (fileName.size())
             return CmdExec::errorOption(CMD_OPT_ILLEGAL, options[i]);
@@ -93,7 +104,7 @@ CirReadCmd::exec(const string& option)
    }
    cirMgr = new CirMgr;
 
-   if (!cirMgr->readCircuit(fileName)) {
+   if (!cirMgr->readCircuit(fileName, nThreads)) {
       curCmd = CIRINIT;
       delete cirMgr; cirMgr = 0;
       return CMD_EXEC_ERROR;
@@ -107,7 +118,8 @@ CirReadCmd::exec(const string& option)
 void
 CirReadCmd::usage(ostream& os) const
 {
-   os << "Usage: CIRRead <(string fileName)> [-Replace]" << endl;
+   os << "Usage: CIRRead <(string fileName)> [-Replace] [-Threads (int n)]"
+      << endl;
 }
 
 void
@@ -184,7 +196,7 @@ CirGateCmd::exec(const string& option)
 
    int gateId = -1, level = 0;
    bool doFanin = false, doFanout = false;
-   CirGate* thisGate = 0;
+   CirGate thisGate;
    for (size_t i = 0, n = options.size(); i < n; ++i) {
       bool checkLevel = false;
       if (myStrNCmp("-FANIn", options[i], 5) == 0) {
@@ -227,11 +239,11 @@ CirGateCmd::exec(const string& option)
    }
 
    if (doFanin)
-      thisGate->reportFanin(level);
+      thisGate.reportFanin(level);
    else if (doFanout)
-      thisGate->reportFanout(level);
+      thisGate.reportFanout(level);
    else
-      thisGate->reportGate();
+      thisGate.reportGate();
 
    return CMD_EXEC_DONE;
 }
@@ -327,6 +339,47 @@ CirOptCmd::help() const
         << "perform trivial optimizations\n";
 }
 
+//----------------------------------------------------------------------
+//    CIRCompact
+//----------------------------------------------------------------------
+CmdExecStatus
+CirCompactCmd::exec(const string& option)
+{
+   if (!cirMgr) {
+      cerr << "Error: circuit is not yet constructed!!" << endl;
+      return CMD_EXEC_ERROR;
+   }
+   // check option
+   vector<string> options;
+   CmdExec::lexOptions(option, options);
+
+   if (!options.empty())
+      return CmdExec::errorOption(CMD_OPT_EXTRA, options[0]);
+
+   assert(curCmd != CIRINIT);
+   if (curCmd == CIRSIMULATE) {
+      cerr << "Error: circuit has been simulated!! Do \"CIRFraig\" first!!"
+           << endl;
+      return CMD_EXEC_ERROR;
+   }
+   cirMgr->compact();
+
+   return CMD_EXEC_DONE;
+}
+
+void
+CirCompactCmd::usage(ostream& os) const
+{
+   os << "Usage: CIRCompact" << endl;
+}
+
+void
+CirCompactCmd::help() const
+{
+   cout << setw(15) << left << "CIRCompact: "
+        << "renumber the gates densely\n";
+}
+
 //----------------------------------------------------------------------
 //    CIRSTRash
 //----------------------------------------------------------------------
@@ -374,7 +427,7 @@ CirStrashCmd::help() const
 }
 
 //----------------------------------------------------------------------
-//    CIRSIMulate <-Random | -File <string patternFile>>
+//    CIRSIMulate <-Random [-Threads (int n)] | -File <string patternFile>>
 //                [-Output (string logFile)]
 //----------------------------------------------------------------------
 CmdExecStatus
@@ -391,6 +444,7 @@ CirSimCmd::exec(const string& option)
    ifstream patternFile;
    ofstream logFile;
    bool doRandom = false, doFile = false, doLog = false;
+   int nThreads = 0;
    for (size_t i = 0, n = options.size(); i < n; ++i) {
       if (myStrNCmp("-Random", options[i], 2) == 0) {
          if (doRandom || doFile)
@@ -407,6 +461,14 @@ CirSimCmd::exec(const string& option)
             return CmdExec::errorOption(CMD_OPT_FOPEN_FAIL, options[i]);
          doFile = true;
       }
+      else if (myStrNCmp("-Threads", options[i], 2) == 0) {
+         if (nThreads)
+            return CmdExec::errorOption(CMD_OPT_EXTRA, options[i]);
+         if (++i == n)
+            return CmdExec::errorOption(CMD_OPT_MISSING, options[i-1]);
+         if (!myStr2Int(options[i], nThreads) || nThreads <= 0)
+            return CmdExec::errorOption(CMD_OPT_ILLEGAL, options[i]);
+      }
       else if (myStrNCmp("-Output", options[i], 2) == 0) {
          if (doLog)
             return CmdExec::errorOption(CMD_OPT_ILLEGAL, options[i]);
@@ -423,6 +485,8 @@ CirSimCmd::exec(const string& option)
 
    if (!doRandom && !doFile)
       return CmdExec::errorOption(CMD_OPT_MISSING, "");
+   if (nThreads && !doRandom)
+      return CmdExec::errorOption(CMD_OPT_ILLEGAL, "-Threads");
 
    assert (curCmd != CIRINIT);
    if (doLog)
@@ -430,7 +494,7 @@ CirSimCmd::exec(const string& option)
    else cirMgr->setSimLog(0);
 
    if (doRandom)
-      cirMgr->randomSim();
+      cirMgr->randomSim(nThreads? nThreads: 1);
    else
       cirMgr->fileSim(patternFile);
    cirMgr->setSimLog(0);
@@ -442,7 +506,8 @@ CirSimCmd::exec(const string& option)
 void
 CirSimCmd::usage(ostream& os) const
 {
-   os << "Usage: CIRSIMulate <-Random | -File <string patternFile>>\n"
+   os << "Usage: CIRSIMulate <-Random [-Threads (int n)] |\n"
+      << "                    -File <string patternFile>>\n"
       << "                   [-Output (string logFile)]" << endl;
 }
 
@@ -454,7 +519,7 @@ CirSimCmd::help() const
 }
 
 //----------------------------------------------------------------------
-//    CIRFraig
+//    CIRFraig [-Threads (int n)] [-Effort (int conflicts)] [-Circuit]
 //----------------------------------------------------------------------
 CmdExecStatus
 CirFraigCmd::exec(const string& option)
@@ -467,14 +532,38 @@ CirFraigCmd::exec(const string& option)
    vector<string> options;
    CmdExec::lexOptions(option, options);
 
-   if (!options.empty())
-      return CmdExec::errorOption(CMD_OPT_EXTRA, options[0]);
+   int nThreads = 0, effort = -1;
+   bool circuit = false;
+   for (size_t i = 0, n = options.size(); i < n; ++i) {
+      if (myStrNCmp("-Threads", options[i], 2) == 0) {
+         if (nThreads)
+            return CmdExec::errorOption(CMD_OPT_EXTRA, options[i]);
+         if (++i == n)
+            return CmdExec::errorOption(CMD_OPT_MISSING, options[i-1]);
+         if (!myStr2Int(options[i], nThreads) || nThreads <= 0)
+            return CmdExec::errorOption(CMD_OPT_ILLEGAL, options[i]);
+      }
+      else if (myStrNCmp("-Effort", options[i], 2) == 0) {
+         if (effort >= 0)
+            return CmdExec::errorOption(CMD_OPT_EXTRA, options[i]);
+         if (++i == n)
+            return CmdExec::errorOption(CMD_OPT_MISSING, options[i-1]);
+         if (!myStr2Int(options[i], effort) || effort < 0)
+            return CmdExec::errorOption(CMD_OPT_ILLEGAL, options[i]);
+      }
+      else if (myStrNCmp("-Circuit", options[i], 2) == 0) {
+         if (circuit)
+            return CmdExec::errorOption(CMD_OPT_EXTRA, options[i]);
+         circuit = true;
+      }
+      else return CmdExec::errorOption(CMD_OPT_EXTRA, options[i]);
+   }
 
    if (curCmd != CIRSIMULATE) {
       cerr << "Error: circuit is not yet simulated!!" << endl;
       return CMD_EXEC_ERROR;
    }
-   cirMgr->fraig();
+   cirMgr->fraig(nThreads? nThreads: 1, effort, circuit);
    curCmd = CIRFRAIG;
 
    return CMD_EXEC_DONE;
@@ -483,7 +572,8 @@ CirFraigCmd::exec(const string& option)
 void
 CirFraigCmd::usage(ostream& os) const
 {
-   os << "Usage: CIRFraig" << endl;
+   os << "Usage: CIRFraig [-Threads (int n)] [-Effort (int conflicts)] [-Circuit]"
+      << endl;
 }
 
 void
@@ -494,7 +584,7 @@ CirFraigCmd::help() const
 }
 
 //----------------------------------------------------------------------
-//    CIRWrite [(int gateId)][-Output (string aagFile)]
+//    CIRWrite [(int gateId)][-Output (string aagFile)][-Binary]
 //----------------------------------------------------------------------
 CmdExecStatus
 CirWriteCmd::exec(const string& option)
@@ -507,34 +597,39 @@ CirWriteCmd::exec(const string& option)
    vector<string> options;
    CmdExec::lexOptions(option, options);
 
+   // The netlist is written to the file descriptor directly, so whatever
+   // is still buffered in cout goes first
+   cout.flush();
    if (options.empty()) {
-      cirMgr->writeAag(cout);
+      cirMgr->writeAag(STDOUT_FILENO);
       return CMD_EXEC_DONE;
    }
-   bool hasFile = false;
+   bool binary = false;
    int gateId;
-   CirGate *thisGate = NULL;
-   ofstream outfile;
+   string fileName;
+   CirGate thisGate;
    for (size_t i = 0, n = options.size(); i < n; ++i) {
-      if (myStrNCmp("-Output", options[i], 2) == 0) {
-         if (hasFile) 
+      if (myStrNCmp("-Binary", options[i], 2) == 0) {
+         if (binary)
+            return CmdExec::errorOption(CMD_OPT_EXTRA, options[i]);
+         binary = true;
+      }
+      else if (myStrNCmp("-Output", options[i], 2) == 0) {
+         if (!fileName.empty()) 
             return CmdExec::errorOption(CMD_OPT_EXTRA, options[i]);
          if (++i == n)
             return CmdExec::errorOption(CMD_OPT_MISSING, options[i-1]);
-         outfile.open(options[i].c_str(), ios::out);
-         if (!outfile)
-            return CmdExec::errorOption(CMD_OPT_FOPEN_FAIL, options[1]);
-         hasFile = true;
+         fileName = options[i];
       }
       else if (myStr2Int(options[i], gateId) && gateId >= 0) {
-         if (thisGate != NULL)
+         if (thisGate)
             return CmdExec::errorOption(CMD_OPT_EXTRA, options[i]);
          thisGate = cirMgr->getGate(gateId);
          if (!thisGate) {
             cerr << "Error: Gate(" << gateId << ") not found!!" << endl;
             return CmdExec::errorOption(CMD_OPT_ILLEGAL, options[i]);
          }
-         if (!thisGate->isAig()) {
+         if (!thisGate.isAig()) {
              cerr << "Error: Gate(" << gateId << ") is NOT an AIG!!" << endl;
             return CmdExec::errorOption(CMD_OPT_ILLEGAL, options[i]);
          }
@@ -542,26 +637,34 @@ CirWriteCmd::exec(const string& option)
       else return CmdExec::errorOption(CMD_OPT_ILLEGAL, options[i]);
    }
 
-   if (!thisGate) {
-      assert (hasFile);
-      cirMgr->writeAag(outfile);
+   // Opened with open(2), so this also works for a named pipe or /dev/fd/<n>
+   int fd = STDOUT_FILENO;
+   if (!fileName.empty()) {
+      fd = ::open(fileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+      if (fd < 0)
+         return CmdExec::errorOption(CMD_OPT_FOPEN_FAIL, fileName);
+   }
+   bool ok = thisGate? cirMgr->writeGate(fd, thisGate.getId(), binary)
+                     : cirMgr->writeAag(fd, binary);
+   if (fd != STDOUT_FILENO) ::close(fd);
+   if (!ok) {
+      cerr << "Error: failed to write the netlist!!" << endl;
+      return CMD_EXEC_ERROR;
    }
-   else if (hasFile) cirMgr->writeGate(outfile, thisGate);
-   else cirMgr->writeGate(cout, thisGate);
-
    return CMD_EXEC_DONE;
 }
 
 void
 CirWriteCmd::usage(ostream& os) const
 {
-   os << "Usage: CIRWrite [(int gateId)][-Output (string aagFile)]" << endl;
+   os << "Usage: CIRWrite [(int gateId)][-Output (string aagFile)][-Binary]"
+      << endl;
 }
 
 void
 CirWriteCmd::help() const
 {
    cout << setw(15) << left << "CIRWrite: "
-        << "write the netlist to an ASCII AIG file (.aag)\n";
+        << "write the netlist to an AIG file (.aag, or .aig with -Binary)\n";
 }
 
@@ -23,10 +23,25 @@ using namespace std;
 class CirGate;
 class CirMgr;
 class SatSolver;
+class ThreadPool;
+class AigWriter;
+struct FraigJob;
+struct SatWorker;
 
-typedef vector<CirGate*>           GateList;
 typedef vector<unsigned>           IdList;
 
+enum GateType
+{
+   UNDEF_GATE = 0,
+   PI_GATE    = 1,
+   PO_GATE    = 2,
+   AIG_GATE   = 3,
+   CONST_GATE = 4,
+   NO_GATE    = 5,   // gate ID not (or no longer) in the circuit
+
+   TOT_GATE
+};
+
 class SimValue
 {
 public:
@@ -54,9 +69,57 @@ private:
    size_t _v;
 };
 
-struct SimHasher
+// Structural hash of AND gates: open addressing with linear probing over
+// one flat array, keyed on the fanin literal pair (in either order). A slot
+// holds the two literals and the gate ID; gate 0 (CONST) marks it empty.
+class AigHash
 {
-   size_t operator () (const SimValue& sv) const { return sv(); }
+public:
+   AigHash(): _mask(0), _size(0) {}
+
+   // empty table for up to n gates, at most half full
+   void init(size_t n) {
+      size_t cap = 16;
+      while (cap < 2 * n) cap <<= 1;
+      _slots.assign(cap, Slot());
+      _mask = cap - 1; _size = 0;
+   }
+   // the gate already stored for (a, b), or "gid" after storing it
+   unsigned insert(unsigned a, unsigned b, unsigned gid) {
+      if (a > b) swap(a, b);
+      if (2 * (_size + 1) > _slots.size()) grow();
+      for (size_t i = hash(a, b); ; i = (i + 1) & _mask) {
+         Slot& s = _slots[i];
+         if (!s.gid) { s.a = a; s.b = b; s.gid = gid; ++_size; return gid; }
+         if (s.a == a && s.b == b) return s.gid;
+      }
+   }
+   size_t size() const { return _size; }
+
+private:
+   struct Slot {
+      Slot(): a(0), b(0), gid(0) {}
+      unsigned a, b, gid;
+   };
+   vector<Slot>   _slots;
+   size_t         _mask;
+   size_t         _size;
+
+   // Fibonacci hashing of the 64-bit key; the high bits are the best mixed
+   size_t hash(unsigned a, unsigned b) const {
+      size_t k = ((size_t(a) << 32) | b) * 0x9E3779B97F4A7C15ull;
+      return (k >> 32) & _mask;
+   }
+   void grow() {
+      vector<Slot> old;
+      old.swap(_slots);
+      init(old.size());
+      for (size_t i = 0; i < old.size(); ++i)
+         if (old[i].gid) insert(old[i].a, old[i].b, old[i].gid);
+   }
 };
 
+// Evaluates a compiled simulation program (see CirMgr::buildSimProg())
+typedef void (*SimKernel)(const unsigned*, const unsigned*, size_t*);
+
 #endif // CIR_DEF_H
@@ -7,11 +7,14 @@
 ****************************************************************************/
 
 #include <cassert>
+#include <cstring>
 #include <queue>
+#include <algorithm>
 #include "cirMgr.h"
 #include "cirGate.h"
 #include "sat.h"
 #include "myHashMap.h"
+#include "myThreadPool.h"
 #include "util.h"
 
 using namespace std;
@@ -22,11 +25,96 @@ using namespace std;
 /*******************************/
 /*   Global variable and enum  */
 /*******************************/
-vector<CirGate*> newinput;
+// One SAT check of fraig(): is gate g equivalent to gate base (or to its
+// complement if inv)? Filled in by CirMgr::solveFraig().
+struct FraigJob
+{
+	FraigJob(unsigned x, unsigned b, bool i)
+	: g(x), base(b), inv(i), result(UNDECIDED) {}
+
+	unsigned    g, base;
+	bool        inv;
+	SatResult   result;
+	IdList      model;		// least counter-example on the PIs in the fanin
+							// cones of g and base, literals 2 * PI + value
+							// (sorted), see CirMgr::minimizeCex()
+};
+
+#define CSAT_UNDEF	2		// SatWorker::cval of an unassigned gate
+
+// A decision of the circuit-based solver: literal "lit" was made true
+// when the trail and the J-frontier had these sizes.
+struct CsatLevel
+{
+	size_t      trail, jfront;
+	unsigned    lit;
+	bool        flipped;	// "lit" failed and is now false
+};
+
+// The solvers of one fraig thread. They live for the whole fraig() run:
+// a gate is encoded the first time a check needs it and its clauses
+// (and everything learned from them) are kept for the later checks.
+struct SatWorker
+{
+	SatWorker(): csatLimit(0) {}
+	void init(size_t n) {
+		s.initialize();
+		s.setDecision(0, false);	// the solver's own unused variable
+		var.assign(n, var_Undef);
+		var[0] = s.newVar();
+		s.assertProperty(var[0], false);
+		cutOf.resize(n);
+		cutLits.assign(1, 0);		// CONST has no inputs
+		cutOf[0] = 0;
+		decVars.clear();
+		nMerged = 0;
+		if (mark.size() != n) { mark.assign(n, 0); stamp = 0; }
+		if (cval.size() != n) cval.assign(n, CSAT_UNDEF);
+	}
+
+	SatSolver       s;
+	vector<Var>     var;		// by gate ID, var_Undef if not encoded yet
+	IdList          mark;		// cone of a check (== stamp)
+	unsigned        stamp;
+	IdList          stack;
+	IdList          cut;		// inputs of a gate in the CNF, see cnfCut()
+	IdList          cutOf;		// cutLits[cutOf[g]]: number of CNF inputs of
+	IdList          cutLits;	//   encoded gate g, followed by them
+	vector<Var>     decVars;	// decision variables, see setConeDecisions()
+	size_t          nMerged;	// encoded gates merged away since init()
+	vec<Lit>        lits;
+
+	// circuit-based solver, see solveCircuit()
+	int             csatLimit;	// conflicts per check, 0: not used
+	int             csatConflicts;
+	vector<unsigned char> cval;	// value of each gate, CSAT_UNDEF between checks
+	IdList          trail;		// assigned gates, in order
+	size_t          qhead;		// trail[qhead...] not propagated yet
+	IdList          jfront;		// gates at 0 with both fanins unknown
+	vector<CsatLevel> levels;
+	IdList          seed;		// its counter-example, sorted
+};
 
 /**************************************/
 /*   Static varaibles and functions   */
 /**************************************/
+// The clauses of a merged gate stay in the solver, and every check still
+// propagates through them. A solver with at least SAT_RECYCLE_MIN
+// variables is started anew once the merged gates are more than
+// SAT_RECYCLE_MERGED percent of them.
+#ifndef SAT_RECYCLE_MIN
+#define SAT_RECYCLE_MIN		5000
+#endif
+#ifndef SAT_RECYCLE_MERGED
+#define SAT_RECYCLE_MERGED	40
+#endif
+
+// "CIRFraig -Circuit": conflicts the circuit-based solver may spend on a
+// check before it is handed to MiniSat.
+#ifndef CSAT_CONFLICTS
+#define CSAT_CONFLICTS		100
+#endif
+
 
 /*******************************************/
 /*   Public member functions about fraig   */
@@ -34,114 +122,641 @@ vector<CirGate*> newinput;
 // _floatList may be changed.
 // _unusedList and _undefList won't be changed
 
-size_t genKey(unsigned x, unsigned y)
-{
-	if (x < y) return ((size_t)x << 32) + y;
-	else return ((size_t)y << 32) + x;
-}
-
+// One probe per gate: the first gate in DFS order with a fanin pair is
+// stored, and every later one is merged into it. A merge rewrites the
+// fanins of gates later in _DFSList, so they are hashed with the new ones.
 void
 CirMgr::strash()
 {
-	unordered_map<size_t, CirGate*> hash;
+	AigHash strash;
+	strash.init(_DFSList.size());
 	for (size_t i = 0; i < _DFSList.size(); ++i){
-		CirGate *gate = _gateList[_DFSList[i]];
-		size_t key = genKey(gate->getFanin()[0], gate->getFanin()[1]);
-		if (hash.find(key) != hash.end()) gate->strashMerge(hash[key]);
-		else hash[key] = gate;
+		unsigned g = _DFSList[i];
+		unsigned base = strash.insert(_fanin[2 * g], _fanin[2 * g + 1], g);
+		if (base != g) strashMerge(g, base);
 	}
-	setDFS();
-	setFU();
+	// A merged gate has the same fanins as its base, which comes first in
+	// _DFSList. Taking it out changes neither the DFS order of the other
+	// gates nor which ones are unused or have a floating fanin.
+	compactDFS();
+	_floatFaninList.erase(remove_if(_floatFaninList.begin(), _floatFaninList.end(),
+		[this](unsigned g) { return !isGate(g); }), _floatFaninList.end());
 }
 
+// With nThreads > 1 the next nThreads candidate pairs in DFS order are
+// solved at once, the k-th of them by worker k. Merging never changes the
+// function of a gate, so an answer stays true however the circuit is
+// merged afterwards. The results are consumed by the same sequential loop
+// as before. When the loop asks for a pair without an answer, the
+// answers of the pairs that are still asked for are kept, and the next
+// nThreads pairs without one are solved.
+// Which counter-example a solver finds depends on what it has solved
+// before, and so on nThreads. The worker therefore makes it the least
+// one (see minimizeCex()), which only depends on the two gates. With
+// every counter-example simulated before the loop goes on, the result is
+// the same for any nThreads. This is paid with one thread as well: a few
+// SAT calls under assumptions per disproved pair, and with circuit the
+// CNF of every pair solveCircuit() disproves.
+// With effort >= 0, a check gives up after "effort" conflicts; the pair
+// is then left unmerged and is not tried again. Whether a check gives up
+// depends on what its solver has seen, so the result may then differ
+// between different nThreads.
+// With circuit, a check is first tried on the AIG itself (solveCircuit()),
+// and only goes to MiniSat if that takes more than CSAT_CONFLICTS.
 void
-CirMgr::fraig()
+CirMgr::fraig(unsigned nThreads, int effort, bool circuit)
 {
-	SatSolver s;
+	if (nThreads == 0) nThreads = 1;
+	ThreadPool pool(nThreads);
+	vector<SatWorker> workers(nThreads);
+	for (unsigned t = 0; t < nThreads; ++t){
+		workers[t].init(_type.size());
+		workers[t].s.setBudget(effort);
+		workers[t].csatLimit = circuit? CSAT_CONFLICTS: 0;
+	}
+	vector<FraigJob> jobs;
+	vector<bool> undecided(_type.size(), false);
+	IdList disproved(_type.size(), NO_FEC);		// base a gate differs from
+	// a gate to check, and its base; a disproved pair stays disproved
+	auto getPair = [&](unsigned x, unsigned& b) {
+		return x && !undecided[x] && getFraigPair(x, b) && disproved[x] != b;
+	};
+	size_t nProved = 0, nDisproved = 0, nUndecided = 0;
+	// A counter-example is simulated right away, in one pass with its
+	// distance-1 variants (one PI of its cone flipped). The patterns are
+	// written straight into the PI words of _simVal, see reSim().
+	const size_t nPatterns = 64 * _simWords;
+	IdList cex;				// see cexCone()
+	IdList cexPIs;			// PIs changed by the patterns
+	vector<bool> isCexPI(_type.size(), false);
+	// Merging leaves the other gates in their _DFSList slots (see
+	// fraigMerge()), so the loop just goes on after a merge. Simulating a
+	// counter-example can only give a new pair to the gate just disproved,
+	// so the loop goes back to it. (A counter-example through a floating
+	// gate may split nothing, hence "disproved".)
 	for (int i = 0; i < (int)_DFSList.size(); ++i){
-		if (_fecFriends.find(_DFSList[i]) == _fecFriends.end()) continue;
-		FecGrp& grp = *(_fecFriends[_DFSList[i]]);
-		if (grp.getBase() / 2 == _DFSList[i]) continue;
-		CirGate *base = _gateList[grp.getBase() / 2], *g = _gateList[_DFSList[i]];
-		initSat(s, base, g);
-		Var newV = s.newVar();
-		bool same = base->getSimVal() != g->getSimVal();	// false if same
-		s.addXorCNF(newV, base->getVar(), false, g->getVar(), same);
-		s.assumeRelease();  // Clear assumptions
-		s.assumeProperty(_gateList[0]->getVar(), false);
-		s.assumeProperty(newV, true);  // k = 1
-		if (!s.assumpSolve()){
+		unsigned g = _DFSList[i], base;
+		if (!getPair(g, base)) continue;
+		bool same = getSimVal(base) != getSimVal(g);	// false if same
+		FraigJob* job = 0;
+		for (size_t k = 0; k < jobs.size() && !job; ++k)
+			if (jobs[k].g == g && jobs[k].base == base &&
+				jobs[k].inv == same) job = &jobs[k];
+		if (!job){
+			size_t n = 0;
+			for (size_t k = 0; k < jobs.size(); ++k){
+				unsigned b, x = jobs[k].g;
+				if (getPair(x, b) && b == jobs[k].base &&
+					(getSimVal(b) != getSimVal(x)) == jobs[k].inv)
+					jobs[n++] = jobs[k];
+			}
+			jobs.erase(jobs.begin() + n, jobs.end());
+			for (size_t j = i; j < _DFSList.size() && jobs.size() < n + nThreads; ++j){
+				unsigned b, x = _DFSList[j];
+				if (!getPair(x, b)) continue;
+				bool inv = getSimVal(b) != getSimVal(x);
+				size_t k = 0;
+				while (k < n && !(jobs[k].g == x && jobs[k].base == b && jobs[k].inv == inv)) ++k;
+				if (k == n) jobs.push_back(FraigJob(x, b, inv));
+			}
+			pool.run(jobs.size() - n, [&](size_t k) { solveFraig(jobs[n + k], workers[k]); });
+			job = &jobs[n];
+		}
+		if (job->result == UNSAT){
 			#ifdef LOG_DEBUG
-			cout << "Fraig: " << base->getId() << " merging "
-				 << (same?"!":"") << g->getId() << "...\n";
+			cout << "Fraig: " << base << " merging "
+				 << (same?"!":"") << g << "...\n";
 			#endif // LOG_DEBUG
-			g->fraigMerge(base);
-			i = base->getPos() - 1;
+			for (unsigned t = 0; t < nThreads; ++t)
+				if (workers[t].var[g] != var_Undef) ++workers[t].nMerged;
+			fraigMerge(g, base);
+			++nProved;
 		}
-		else reSim(s);
-		newinput.clear();
+		else if (job->result == SAT){
+			++nDisproved;
+			disproved[g] = base;
+			cexCone(g, base, job->model, cex);
+			const IdList& m = cex;
+			for (size_t k = 0; k < m.size(); ++k)
+				if (!isCexPI[m[k] / 2])
+				{ isCexPI[m[k] / 2] = true; cexPIs.push_back(m[k] / 2); }
+			addCexPattern(m, 0, 0);
+			for (size_t k = 0; k < m.size() && k + 1 < nPatterns; ++k)
+				addCexPattern(m, k + 1, m[k] / 2);
+			reSim(cexPIs, isCexPI);
+			--i;
+		}
+		else { undecided[g] = true; ++nUndecided; }
 	}
 	setDFS();
 	setFU();
 	endFraig();
+	#ifdef LOG_DEBUG
+	cout << "Fraig: " << nProved << " proved, " << nDisproved << " disproved, "
+		 << nUndecided << " undecided\n";
+	#endif // LOG_DEBUG
 }
 
 /********************************************/
 /*   Private member functions about fraig   */
 /********************************************/
 void
-CirMgr::initSat(SatSolver& s, CirGate* base, CirGate* gate)
+CirMgr::strashMerge(unsigned gid, unsigned base)
 {
-	s.initialize();
-	_gateList[0]->setVar(s.newVar());
-	_gateList[0]->setRef();
-	genProofModel(s, base);
-	genProofModel(s, gate);
-	CirGate::setGlobalRef();
+	#ifdef LOG_DEBUG
+	cout << "Strashing: " << base << " merging " << gid << "...\n";
+	#endif // LOG_DEBUG
+	for (unsigned i = 0; i < _foSize[gid]; ++i){
+		unsigned out = getFanout(gid, i);
+		unsigned j = replaceFanin(out / 2, gid, 2 * base + out % 2);
+		addFanout(base, out, j);
+		checkPO(out / 2);
+	}
+	_dfsRef[base] += _dfsRef[gid];
+	_DFSList[_pos[gid] - 1] = 0;
+	for (unsigned i = 0; i < 2; ++i){
+		deleteFanout(_fanin[2 * gid + i] / 2, gid);
+		--_dfsRef[_fanin[2 * gid + i] / 2];
+	}
+	--_A;
+	removeGate(gid);
 }
 
+// _DFSList keeps its order during fraig: "gid" and the gates that only
+// fed it leave their slots (see removeFromDFS()), and "base" is before
+// all the fanouts it takes over. _pos thus stays valid throughout.
 void
-CirMgr::genProofModel(SatSolver& s, CirGate* gate)
+CirMgr::fraigMerge(unsigned gid, unsigned base)
 {
-	if (gate->isActive()) return;
-	if (gate->isPI()){
-		gate->setVar(s.newVar());
-		newinput.push_back(gate);
-		gate->setRef(); return;
+	bool inv = getSimVal(base) != getSimVal(gid);
+	for (unsigned i = 0; i < _foSize[gid]; ++i){
+		unsigned out = getFanout(gid, i);
+		unsigned newfanin = 2 * base + (out + inv) % 2;
+		unsigned j = replaceFanin(out / 2, gid, newfanin);
+		addFanout(base, out / 2 * 2 + newfanin % 2, j);
+		checkPO(out / 2);
 	}
-	assert(gate->isAig());
-	unsigned g[2] = { gate->getFanin()[0], gate->getFanin()[1] };
-	for (int i = 0; i < 2; ++i)
-		genProofModel(s, gate->getGate(g[i]));
-	gate->setVar(s.newVar());
-	s.addAigCNF(gate->getVar(), _gateList[g[0] / 2]->getVar(),
-				g[0] % 2, _gateList[g[1] / 2]->getVar(), g[1] % 2);
-	gate->setRef();
+	_dfsRef[base] += _dfsRef[gid];
+	_dfsRef[gid] = 0;
+	removeFromDFS(gid);
+	for (unsigned i = 0; i < 2; ++i)
+		deleteFanout(_fanin[2 * gid + i] / 2, gid);
+	--_A;
+	removeGate(gid);
 }
 
+// "gid" is no longer used by _DFSList or the POs: clear its slot and
+// those of the gates only it was using, and take them out of the FEC
+// groups. The work is proportional to the part of the cone that is lost.
 void
-CirMgr::reSim(const SatSolver& s)
+CirMgr::removeFromDFS(unsigned gid)
 {
-	for (size_t i = 0; i < _PIList.size(); ++i)
-		_gateList[_PIList[i] / 2]->setSimVal(rnGenSize_t());
-	for (size_t i = 0; i < newinput.size(); ++i)
-		newinput[i]->setSimVal(s.getValue(newinput[i]->getVar()));
-	simulate(true);
-	setFecFriends();
+	IdList& stack = _dfsStack;
+	stack.assign(1, gid);
+	while (!stack.empty()){
+		unsigned g = stack.back(); stack.pop_back();
+		_DFSList[_pos[g] - 1] = 0;
+		eraseFEC(g);
+		for (unsigned i = 0; i < 2; ++i){
+			unsigned in = _fanin[2 * g + i] / 2;
+			if (--_dfsRef[in] == 0 && _type[in] == AIG_GATE) stack.push_back(in);
+		}
+	}
+}
+
+// true if gid is in a FEC group but is not its base
+bool
+CirMgr::getFraigPair(unsigned gid, unsigned& base) const
+{
+	if (_fecOf[gid] == NO_FEC) return false;
+	base = _fecBase[_fecOf[gid]] / 2;
+	return base != gid;
+}
+
+// Prove or disprove "job.g == job.base (^ job.inv)" with the solver of one
+// thread, only by assuming the miter variable. Reads the circuit only.
+void
+CirMgr::solveFraig(FraigJob& job, SatWorker& w) const
+{
+	if (w.csatLimit){
+		solveCircuit(job, w);
+		if (job.result == UNSAT) return;
+		if (job.result == SAT) { w.seed.swap(job.model); ::sort(w.seed.begin(), w.seed.end()); }
+	}
+	SatSolver& s = w.s;
+	if (s.nVars() >= SAT_RECYCLE_MIN &&
+		100 * w.nMerged > SAT_RECYCLE_MERGED * size_t(s.nVars()))
+		w.init(_type.size());
+	genProofModel(w, job.base);
+	genProofModel(w, job.g);
+	Var miter = s.newVar();
+	s.setDecision(miter, false);
+	s.addXorCNF(miter, w.var[job.base], false, w.var[job.g], job.inv);
+	setConeDecisions(w, job);
+	::sort(job.model.begin(), job.model.end());
+	if (job.result == SAT){
+		// the PIs solveCircuit() left unassigned can be anything
+		for (size_t i = 0, j = 0; i < job.model.size(); ++i){
+			while (j < w.seed.size() && w.seed[j] < job.model[i]) ++j;
+			if (j < w.seed.size() && w.seed[j] / 2 == job.model[i] / 2)
+				job.model[i] = w.seed[j];
+		}
+		minimizeCex(w, job, miter);
+		return;
+	}
+	s.assumeRelease();  // Clear assumptions
+	s.assumeProperty(miter, true);
+	if ((job.result = s.assumpSolve()) == SAT){
+		for (size_t i = 0; i < job.model.size(); ++i)
+			job.model[i] |= s.getValue(w.var[job.model[i] / 2]) == 1;
+		minimizeCex(w, job, miter);
+	}
+	else job.model.clear();
+	// proved equivalent: tie the two variables for the later checks
+	if (job.result == UNSAT) s.assertProperty(miter, false);
+}
+
+// Make the counter-example in job.model (sorted by PI) the least one, in
+// the order of the PI IDs, see SatSolver::assumpLexMin(). It depends on
+// the functions of job.g and job.base only, not on what the solver has
+// seen; a PI they do not depend on is 0. It is searched without the
+// effort budget.
+void
+CirMgr::minimizeCex(SatWorker& w, FraigJob& job, Var miter) const
+{
+	IdList& m = job.model;
+	markCone(w, job);
+	m.erase(remove_if(m.begin(), m.end(),
+		[&w](unsigned l) { return w.mark[l / 2] != w.stamp; }), m.end());
+	w.lits.clear();
+	for (size_t i = 0; i < m.size(); ++i)
+		w.lits.push(Lit(w.var[m[i] / 2], m[i] % 2 == 0));
+	w.s.assumeRelease();
+	w.s.assumeProperty(miter, true);
+	w.s.assumpLexMin(w.lits);
+	for (size_t i = 0; i < m.size(); ++i)
+		m[i] = m[i] / 2 * 2 + !sign(w.lits[i]);
+}
+
+// The counter-example of a disproved pair as it goes into the patterns:
+// the PIs in the fanin cones of g and base, sorted, with their values in
+// "model" (sorted, see minimizeCex()), or 0. A PI the model does not have
+// is one the two gates do not depend on.
+void
+CirMgr::cexCone(unsigned g, unsigned base, const IdList& model, IdList& cex) const
+{
+	cex.clear();
+	unsigned roots[2] = { g, base };
+	for (unsigned r : roots){
+		if (isActive(r)) continue;
+		setRef(r);
+		faninDFS(_dfsStack, r, [this](unsigned, unsigned f) {
+				if (isActive(f / 2)) return false;
+				setRef(f / 2); return true;
+			}, [this, &cex](unsigned x) { if (_type[x] == PI_GATE) cex.push_back(2 * x); });
+	}
+	setGlobalRef();
+	::sort(cex.begin(), cex.end());
+	for (size_t i = 0, j = 0; i < cex.size(); ++i){
+		while (j < model.size() && model[j] < cex[i]) ++j;
+		if (j < model.size() && model[j] / 2 == cex[i] / 2) cex[i] = model[j];
+	}
+}
+
+// Make the variables in the CNF cones of job.g and job.base the only
+// decision variables of w.s, and list the PIs among them in job.model.
+// The cones follow the cuts the gates were encoded with, which may go
+// through gates merged since. A SAT answer then assigns these cones only,
+// and the PIs are a counter-example: the clauses of the other gates hold
+// when they get the values they have under the same PIs. Without this,
+// MiniSat would assign every variable (of all the earlier checks as well)
+// before it answers SAT.
+void
+CirMgr::setConeDecisions(SatWorker& w, FraigJob& job) const
+{
+	SatSolver& s = w.s;
+	for (size_t i = 0; i < w.decVars.size(); ++i)
+		s.setDecision(w.decVars[i], false);
+	w.decVars.clear();
+	job.model.clear();
+	++w.stamp;
+	w.stack.assign(1, job.g);
+	w.stack.push_back(job.base);
+	while (!w.stack.empty()){
+		unsigned x = w.stack.back(); w.stack.pop_back();
+		if (w.mark[x] == w.stamp) continue;
+		w.mark[x] = w.stamp;
+		w.decVars.push_back(w.var[x]);
+		s.setDecision(w.var[x], true);
+		const unsigned* c = &w.cutLits[w.cutOf[x]];
+		for (unsigned i = 1; i <= c[0]; ++i) w.stack.push_back(c[i] / 2);
+		if (_type[x] == PI_GATE) job.model.push_back(2 * x);
+	}
+}
+
+// Encode the fanin cone of "gate" down to the gates already in w.s.
+// The CNF is not built on the AIG but on the cuts of cnfCut(): a MUX or
+// XOR of three ANDs is 4 clauses, and an AND tree is one wide AND. The
+// gates inside a cut get no variable, unless a later check needs them.
+void
+CirMgr::genProofModel(SatWorker& w, unsigned gate) const
+{
+	// a PI or UNDEF gets its variable when reached, an AIG after its cut
+	auto enter = [this, &w](unsigned id) {
+		if (w.var[id] != var_Undef) return false;
+		if (_type[id] == PI_GATE || _type[id] == UNDEF_GATE){
+			w.var[id] = w.s.newVar();
+			w.cutOf[id] = w.cutLits.size();
+			w.cutLits.push_back(0);
+			return false;
+		}
+		assert(_type[id] == AIG_GATE);
+		return true;
+	};
+	if (!enter(gate)) return;
+	// 2 * g: g is reached, 2 * g + 1: the inputs of its cut are encoded
+	IdList& stack = w.stack;
+	stack.assign(1, 2 * gate);
+	while (!stack.empty()){
+		unsigned x = stack.back(), g = x / 2;
+		stack.pop_back();
+		if (w.var[g] != var_Undef) continue;	// reached twice
+		bool mux = cnfCut(w, g, w.cut);
+		if (x % 2 == 0){
+			stack.push_back(x + 1);
+			for (size_t i = 0; i < w.cut.size(); ++i)
+				if (enter(w.cut[i] / 2)) stack.push_back(w.cut[i] / 2 * 2);
+			continue;
+		}
+		const IdList& c = w.cut;
+		w.var[g] = w.s.newVar();
+		w.cutOf[g] = w.cutLits.size();
+		w.cutLits.push_back(c.size());
+		w.cutLits.insert(w.cutLits.end(), c.begin(), c.end());
+		if (mux)
+			w.s.addMuxCNF(w.var[g], w.var[c[0] / 2], c[0] % 2,
+				w.var[c[1] / 2], c[1] % 2, w.var[c[2] / 2], c[2] % 2);
+		else {
+			w.lits.clear();
+			for (size_t i = 0; i < c.size(); ++i)
+				w.lits.push(Lit(w.var[c[i] / 2], c[i] % 2));
+			w.s.addAndCNF(w.var[g], w.lits);
+		}
+	}
+}
+
+// The inputs (literals) of AIG "g" in the CNF. If g = !(s & t) & !(!s & e)
+// and the two ANDs have no other fanout, g = s? !t: !e is a MUX (or an
+// XOR) and "cut" is {s, !t, !e}; true is returned. Otherwise "cut" holds
+// the leaves of the AND tree at g, which goes on through the
+// non-inverted AIG fanins that have a single fanout.
+// An AIG with a variable already is always a leaf, so the cut of a gate
+// does not change while its inputs are encoded.
+bool
+CirMgr::cnfCut(const SatWorker& w, unsigned g, IdList& cut) const
+{
+	auto inner = [this, &w](unsigned f) {
+		return _type[f / 2] == AIG_GATE && _foSize[f / 2] == 1 &&
+			w.var[f / 2] == var_Undef;
+	};
+	unsigned f0 = _fanin[2 * g], f1 = _fanin[2 * g + 1];
+	cut.clear();
+	if (f0 % 2 && f1 % 2 && inner(f0) && inner(f1)){
+		const unsigned* a = &_fanin[f0 / 2 * 2];
+		const unsigned* b = &_fanin[f1 / 2 * 2];
+		for (unsigned i = 0; i < 2; ++i)
+			for (unsigned j = 0; j < 2; ++j)
+				if (a[i] == (b[j] ^ 1)){
+					cut.push_back(a[i]);
+					cut.push_back(a[1 - i] ^ 1);
+					cut.push_back(b[1 - j] ^ 1);
+					return true;
+				}
+	}
+	cut.push_back(f0);
+	cut.push_back(f1);
+	for (size_t k = 0; k < cut.size(); ){
+		unsigned f = cut[k];
+		if (f % 2 || !inner(f)) { ++k; continue; }
+		cut[k] = _fanin[f / 2 * 2];
+		cut.push_back(_fanin[f / 2 * 2 + 1]);
+	}
+	return false;
+}
+
+// Mark the gates in the fanin cones of job.g and job.base with w.stamp.
+void
+CirMgr::markCone(SatWorker& w, const FraigJob& job) const
+{
+	++w.stamp;
+	unsigned roots[2] = { job.g, job.base };
+	for (unsigned r : roots){
+		if (w.mark[r] == w.stamp) continue;
+		w.mark[r] = w.stamp;
+		faninDFS(w.stack, r, [&w](unsigned, unsigned f) {
+				if (w.mark[f / 2] == w.stamp) return false;
+				w.mark[f / 2] = w.stamp; return true;
+			}, [](unsigned) {});
+	}
+}
+
+// Circuit-based SAT: decide "job.g != job.base (^ job.inv)" on the AIG,
+// without CNF. Only the gates in the fanin cones of the two are looked
+// at. A gate value is implied from its fanins and its fanouts, and a gate
+// at 0 whose fanins are both unknown is left unjustified in the J-frontier.
+// A decision sets the first fanin of the latest such gate to 0 (and to 1
+// when that fails); when no gate is left unjustified, the PIs assigned so
+// far are a counter-example, whatever the others are. There is no
+// learning, so after w.csatLimit conflicts the result is UNDECIDED.
+void
+CirMgr::solveCircuit(FraigJob& job, SatWorker& w) const
+{
+	markCone(w, job);
+	// the two literals differ: g = 1, base = 0 or g = 0, base = 1
+	unsigned a = 2 * job.g, b = 2 * job.base + job.inv;
+	w.csatConflicts = 0;
+	job.model.clear();
+	SatResult r1 = csatSolve(w, a, b ^ 1, job.model);
+	SatResult r2 = r1 == SAT? SAT: csatSolve(w, a ^ 1, b, job.model);
+	job.result = r2 == SAT? SAT: (r1 == UNSAT && r2 == UNSAT? UNSAT: UNDECIDED);
+}
+
+// value of literal "lit", or CSAT_UNDEF
+inline unsigned char
+CirMgr::csatValue(const SatWorker& w, unsigned lit) const
+{
+	unsigned char v = w.cval[lit / 2];
+	return v == CSAT_UNDEF? v: v ^ (lit % 2);
+}
+
+// Make literals "l0" and "l1" true. On SAT, the PIs assigned are added
+// to "model" (2 * PI + value). Leaves every gate unassigned.
+SatResult
+CirMgr::csatSolve(SatWorker& w, unsigned l0, unsigned l1, IdList& model) const
+{
+	SatResult r = UNSAT;
+	w.qhead = 0;
+	w.levels.clear();
+	bool ok = csatAssign(w, 1) && csatAssign(w, l0) && csatAssign(w, l1);
+	while (ok){
+		if (!csatPropagate(w)){
+			// chronological backtracking to the last unflipped decision
+			while (!w.levels.empty() && w.levels.back().flipped) w.levels.pop_back();
+			if (w.levels.empty()) break;
+			if (++w.csatConflicts > w.csatLimit) { r = UNDECIDED; break; }
+			CsatLevel& l = w.levels.back();
+			csatUndo(w, l.trail, l.jfront);
+			l.flipped = true;
+			csatAssign(w, l.lit ^ 1);
+			continue;
+		}
+		// latest unjustified gate; the justified ones of this level go
+		size_t jmin = w.levels.empty()? 0: w.levels.back().jfront;
+		unsigned j = 0;
+		for (size_t k = w.jfront.size(); k-- > 0 && !j; ){
+			unsigned x = w.jfront[k];
+			if (csatValue(w, _fanin[2 * x]) == CSAT_UNDEF &&
+				csatValue(w, _fanin[2 * x + 1]) == CSAT_UNDEF) j = x;
+			else if (k + 1 == w.jfront.size() && k >= jmin) w.jfront.pop_back();
+		}
+		if (!j){
+			for (size_t k = 0; k < w.trail.size(); ++k)
+				if (_type[w.trail[k]] == PI_GATE)
+					model.push_back(2 * w.trail[k] + w.cval[w.trail[k]]);
+			r = SAT;
+			break;
+		}
+		CsatLevel l = { w.trail.size(), w.jfront.size(), _fanin[2 * j] ^ 1, false };
+		w.levels.push_back(l);
+		csatAssign(w, l.lit);
+	}
+	csatUndo(w, 0, 0);
+	return r;
+}
+
+// Make literal "lit" true; false if it is already false.
+bool
+CirMgr::csatAssign(SatWorker& w, unsigned lit) const
+{
+	unsigned char& v = w.cval[lit / 2];
+	if (v == CSAT_UNDEF){
+		v = 1 ^ (lit % 2);
+		w.trail.push_back(lit / 2);
+		return true;
+	}
+	return v == (1 ^ (lit % 2));
+}
+
+// Unassign the gates after trail[t] and drop the J-frontier after jfront[jf]
+void
+CirMgr::csatUndo(SatWorker& w, size_t t, size_t jf) const
+{
+	for (size_t k = t; k < w.trail.size(); ++k) w.cval[w.trail[k]] = CSAT_UNDEF;
+	w.trail.resize(t);
+	assert(jf <= w.jfront.size());
+	w.jfront.resize(jf);
+	w.qhead = t;
+}
+
+// Process the newly assigned gates: the AND rules of each gate and of its
+// fanouts in the cone. False on a conflict.
+bool
+CirMgr::csatPropagate(SatWorker& w) const
+{
+	while (w.qhead < w.trail.size()){
+		unsigned g = w.trail[w.qhead++];
+		if (_type[g] == AIG_GATE){
+			if (w.cval[g] == 0 && csatValue(w, _fanin[2 * g]) == CSAT_UNDEF &&
+				csatValue(w, _fanin[2 * g + 1]) == CSAT_UNDEF)
+				w.jfront.push_back(g);
+			else if (!csatImply(w, g)) return false;
+		}
+		for (unsigned i = 0; i < _foSize[g]; ++i){
+			unsigned o = getFanout(g, i) / 2;
+			if (w.mark[o] == w.stamp && !csatImply(w, o)) return false;
+		}
+	}
+	return true;
+}
+
+// The rules of AND gate "g" for the values it and its fanins have now
+bool
+CirMgr::csatImply(SatWorker& w, unsigned g) const
+{
+	unsigned a = _fanin[2 * g], b = _fanin[2 * g + 1];
+	unsigned char va = csatValue(w, a), vb = csatValue(w, b);
+	switch (w.cval[g]){
+		case CSAT_UNDEF:
+			if (va == 0 || vb == 0) return csatAssign(w, 2 * g + 1);
+			if (va == 1 && vb == 1) return csatAssign(w, 2 * g);
+			return true;
+		case 1:
+			return csatAssign(w, a) && csatAssign(w, b);
+		default:
+			if (va == 1) return csatAssign(w, b ^ 1);
+			if (vb == 1) return csatAssign(w, a ^ 1);
+			return true;
+	}
+}
+
+// Write counter-example "model" into pattern k of the PI words in
+// _simVal, with PI "flip" inverted unless it is 0 (the constant is never
+// a PI). Other PIs keep their bits, so only the cones of the model PIs
+// have to be simulated again.
+void
+CirMgr::addCexPattern(const IdList& model, size_t k, unsigned flip)
+{
+	size_t w = k / 64, m = size_t(1) << (k % 64);
+	for (size_t i = 0; i < model.size(); ++i){
+		size_t& word = _simVal[model[i] / 2 * _simWords + w];
+		if ((model[i] % 2) ^ (model[i] / 2 == flip)) word |= m;
+		else word &= ~m;
+	}
+}
+
+// Incremental refinement after the PIs in "pis" got new patterns: only
+// their transitive fanouts are simulated (in DFS order), and only the FEC
+// groups with a member among them are split again. Clears "pis".
+void
+CirMgr::reSim(IdList& pis, vector<bool>& isPI)
+{
+	IdList& tfo = _tfoList;
+	tfo.clear();
+	for (size_t i = 0; i < pis.size(); ++i) setRef(pis[i]);
+	for (size_t i = 0; i < pis.size() + tfo.size(); ++i){
+		unsigned g = i < pis.size()? pis[i]: tfo[i - pis.size()];
+		for (unsigned j = 0; j < _foSize[g]; ++j){
+			unsigned out = getFanout(g, j) / 2;
+			// floating gates (with a stale _pos) are in no FEC group
+			if (_type[out] != AIG_GATE || isActive(out) ||
+				_pos[out] - 1 >= _DFSList.size() || _DFSList[_pos[out] - 1] != out)
+				continue;
+			setRef(out);
+			tfo.push_back(out);
+		}
+	}
+	setGlobalRef();
+	for (size_t i = 0; i < pis.size(); ++i) isPI[pis[i]] = false;
+	pis.clear();
+
+	::sort(tfo.begin(), tfo.end(), [this](unsigned a, unsigned b)
+		{ return _pos[a] < _pos[b]; });
+	IdList& prog = _tfoProg;
+	prog.resize(3 * tfo.size());
+	for (size_t i = 0; i < tfo.size(); ++i){
+		prog[3 * i] = tfo[i];
+		prog[3 * i + 1] = _fanin[2 * tfo[i]];
+		prog[3 * i + 2] = _fanin[2 * tfo[i] + 1];
+	}
+	_simKernel(prog.data(), prog.data() + prog.size(), _simVal.data());
+	refineFECs(tfo);
 }
 
 void
 CirMgr::endFraig()
 {
-	for (size_t i = 0; i < _PIList.size(); ++i)
-		_gateList[_PIList[i] / 2]->setSimVal(0);
-	for (size_t i = 0; i < _DFSList.size(); ++i)
-		_gateList[_DFSList[i]]->setSimVal(0);
-	for (size_t i = 0; i < _POList.size(); ++i)
-		_gateList[_M + 1 + i]->setSimVal(0);
-	for (size_t i = 0; i < _fecGrps.size(); ++i) delete _fecGrps[i];
-	_fecGrps.clear();
-	_fecFriends.clear();
+	fill(_simVal.begin(), _simVal.end(), 0);
+	clearFECs();
 	_isSimulated = false;
 	_isFraiged = true;
 }
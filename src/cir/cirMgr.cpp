@@ -13,9 +13,15 @@
 #include <ctype.h>
 #include <cassert>
 #include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "cirMgr.h"
 #include "cirGate.h"
 #include "myHashMap.h"
+#include "myThreadPool.h"
 #include "util.h"
 //#define ERROR_HANDLE
 
@@ -34,12 +40,146 @@ IdList writeAIG;
 /**************************************/
 static unsigned lineNo = 0;  // in printint, lineNo needs to ++
 static unsigned colNo  = 0;  // in printing, colNo needs to ++
-static char buf[1024];
+#define MAX_SYMBOL_LEN 1023        // longer names are a MISSING_NEWLINE
+// Smaller AND sections and fanout tables are built on one thread
+#ifndef PARALLEL_READ_MIN
+#define PARALLEL_READ_MIN (1 << 16)
+#endif
 static string errMsg;
 static int errInt;
-static CirGate *errGate;
+static CirGate errGate;
 static unsigned count = 0;
 
+// The design file as one read-only buffer. It is mapped into memory when
+// possible, so that the parser scans the page cache directly without any
+// copy; what cannot be mapped (e.g. a pipe) is read into memory instead.
+class AigFile
+{
+public:
+   AigFile(): _data(0), _size(0), _mapped(false) {}
+   ~AigFile() { close(); }
+
+   bool open(const string& name) {
+      close();
+      int fd = ::open(name.c_str(), O_RDONLY);
+      if (fd < 0) return false;
+      struct stat st;
+      if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+         void* p = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+         if (p != MAP_FAILED) {
+            madvise(p, st.st_size, MADV_SEQUENTIAL);
+            _data = (const char*)p; _size = st.st_size; _mapped = true;
+            ::close(fd);
+            return true;
+         }
+      }
+      char b[1 << 16];
+      ssize_t n;
+      while ((n = ::read(fd, b, sizeof(b))) > 0)
+         _buf.insert(_buf.end(), b, b + n);
+      ::close(fd);
+      _data = _buf.data(); _size = _buf.size();
+      return n == 0;
+   }
+   void close() {
+      if (_mapped) munmap((void*)_data, _size);
+      _data = 0; _size = 0; _mapped = false;
+      _buf.clear();
+   }
+   const char* begin() const { return _data; }
+   const char* end() const { return _data + _size; }
+
+private:
+   const char*    _data;
+   size_t         _size;
+   bool           _mapped;
+   vector<char>   _buf;
+};
+
+// Read position in the file being parsed by readCircuit(). Line numbers
+// of a binary ("aig") file are those of the equivalent ASCII file, i.e.
+// the PIs and the AIGs count one line each.
+static const char* cur = 0;
+static const char* fend = 0;
+static bool isBinary = false;
+
+static inline int peekChar() { return cur < fend? (unsigned char)*cur: EOF; }
+static inline int getChar() { return cur < fend? (unsigned char)*cur++: EOF; }
+
+// Output side of AigFile: the netlist is formatted into one buffer, which
+// is reused by every write, and handed to the file descriptor in large
+// write() calls. The buffer is flushed when the writer goes out of scope.
+#define WRITE_BUF_SIZE (1 << 20)
+static vector<char> writeBuf;
+
+class AigWriter
+{
+public:
+   AigWriter(int fd): _fd(fd), _n(0), _ok(true) {
+      if (writeBuf.empty()) writeBuf.resize(WRITE_BUF_SIZE);
+      _buf = writeBuf.data();
+   }
+   ~AigWriter() { flush(); }
+
+   AigWriter& operator << (char c) {
+      if (_n == WRITE_BUF_SIZE) flush();
+      _buf[_n++] = c; return *this;
+   }
+   AigWriter& operator << (const char* s) { return put(s, strlen(s)); }
+   AigWriter& operator << (const string& s) { return put(s.data(), s.size()); }
+   AigWriter& operator << (unsigned x) { return num(x); }
+   AigWriter& operator << (size_t x) { return num(x); }
+   AigWriter& operator << (int x) {
+      if (x < 0) { *this << '-'; return num(-(size_t)x); }
+      return num(x);
+   }
+
+   // One delta of a binary AND gate, see readDelta()
+   void delta(unsigned x) {
+      if (_n + 5 > WRITE_BUF_SIZE) flush();
+      for (; x & ~0x7fu; x >>= 7) _buf[_n++] = char((x & 0x7f) | 0x80);
+      _buf[_n++] = char(x);
+   }
+   // false if any write() has failed
+   bool flush() { writeAll(_buf, _n); _n = 0; return _ok; }
+
+private:
+   int      _fd;
+   char*    _buf;
+   size_t   _n;
+   bool     _ok;
+
+   void writeAll(const char* s, size_t n) {
+      for (size_t i = 0; _ok && i < n; ) {
+         ssize_t k = ::write(_fd, s + i, n - i);
+         if (k > 0) i += k;
+         else if (k < 0 && errno != EINTR) _ok = false;
+      }
+   }
+   AigWriter& put(const char* s, size_t n) {
+      if (_n + n > WRITE_BUF_SIZE) {
+         flush();
+         if (n > WRITE_BUF_SIZE) { writeAll(s, n); return *this; }
+      }
+      memcpy(_buf + _n, s, n); _n += n;
+      return *this;
+   }
+   // Two digits per division, written backwards
+   AigWriter& num(size_t x) {
+      static const char digits[] =
+         "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+         "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+         "8081828384858687888990919293949596979899";
+      if (_n + 20 > WRITE_BUF_SIZE) flush();
+      char t[20], *p = t + 20;
+      for (; x >= 100; x /= 100) { p -= 2; memcpy(p, digits + 2 * (x % 100), 2); }
+      if (x >= 10) { p -= 2; memcpy(p, digits + 2 * x, 2); }
+      else *--p = char('0' + x);
+      memcpy(_buf + _n, p, t + 20 - p); _n += t + 20 - p;
+      return *this;
+   }
+};
+
 #ifdef ERROR_HANDLE
 static bool
 parseError(CirParseError err)
@@ -104,7 +244,7 @@ parseError(CirParseError err)
       case REDEF_GATE:
          cerr << "[ERROR] Line " << lineNo+1 << ": Literal \"" << errInt
               << "\" is redefined, previously defined as "
-              << errGate->getTypeStr() << " in line " << errGate->getLineNo()
+              << errGate.getTypeStr() << " in line " << errGate.getLineNo()
               << "!!" << endl;
          break;
       case REDEF_SYMBOLIC_NAME:
@@ -131,13 +271,254 @@ parseError(CirParseError err)
 /**************************************************************/
 /*   class CirMgr member functions for circuit construction   */
 /**************************************************************/
-CirMgr::~CirMgr(){
-   for (size_t i = 0; i < _gateList.size(); ++i)
-      if (_gateList[i]) delete _gateList[i];
+void
+CirMgr::initGates(size_t n)
+{
+   _type.assign(n, NO_GATE);
+   _fanin.assign(2 * n, 0);
+   _lineNo.assign(n, 0);
+   _pos.assign(n, 0);
+   _dfsRef.assign(n, 0);
+   _simVal.assign(n * _simWords, 0);
+   _simProg.clear();
+   _ref.assign(n, 0);
+   _foStart.assign(n, 0);
+   _foSize.assign(n, 0);
+   _foCap.assign(n, 0);
+   _foList.clear();
+   _symOf.clear();
+   _symText.clear();
+   clearFECs();
+   setGate(0, CONST_GATE, 0);
 }
 
-CirParseError checkNoDel(ifstream& fin, string errStr){
-   int d = fin.peek();
+void
+CirMgr::setGate(unsigned gid, GateType t, unsigned l)
+{
+   _type[gid] = t;
+   _lineNo[gid] = l;
+}
+
+// Big circuits are handed to buildFanoutParallel() when there are threads
+void
+CirMgr::buildFanout(ThreadPool& pool)
+{
+   if (_type.size() >= PARALLEL_READ_MIN && pool.size() > 1)
+      buildFanoutParallel(pool);
+   else buildFanout();
+}
+
+// Build the fanout table from the fanin arrays in one counting pass.
+// Fanouts of each gate are ordered by the ID of the fanout gate.
+void
+CirMgr::buildFanout()
+{
+   size_t n = _type.size();
+   _foSize.assign(n, 0);
+   for (unsigned i = 0; i < n; ++i)
+      for (unsigned j = 0, m = getFaninSize(i); j < m; ++j)
+         ++_foSize[_fanin[2 * i + j] / 2];
+   _foStart.resize(n);
+   _foCap.resize(n);
+   unsigned s = 0;
+   for (unsigned i = 0; i < n; ++i){
+      _foStart[i] = s;
+      _foCap[i] = _foSize[i];
+      s += _foSize[i];
+      _foSize[i] = 0;
+   }
+   _foList.resize(s);
+   _foIdx.resize(2 * n);
+   for (unsigned i = 0; i < n; ++i)
+      for (unsigned j = 0, m = getFaninSize(i); j < m; ++j){
+         unsigned f = _fanin[2 * i + j] / 2;
+         _foIdx[2 * i + j] = _foSize[f];
+         _foList[_foStart[f] + _foSize[f]++] = 2 * i + _fanin[2 * i + j] % 2;
+      }
+}
+
+// Same CSR as buildFanout(), with the counting and the filling spread over
+// the threads in ranges of fanout gates. The slots are claimed atomically,
+// so each slot is sorted afterwards to get the sequential order back: by
+// fanout gate, and the first fanin before the second for "g = f & !f".
+void
+CirMgr::buildFanoutParallel(ThreadPool& pool)
+{
+   const size_t n = _type.size(), T = pool.size();
+   _foSize.assign(n, 0);
+   auto range = [&](size_t k, size_t& b, size_t& e)
+      { b = n * k / T; e = n * (k + 1) / T; };
+   pool.run(T, [&](size_t k) {
+      size_t b, e; range(k, b, e);
+      for (size_t i = b; i < e; ++i)
+         for (unsigned j = 0, m = getFaninSize(i); j < m; ++j)
+            __atomic_fetch_add(&_foSize[_fanin[2 * i + j] / 2], 1, __ATOMIC_RELAXED);
+   });
+   _foStart.resize(n);
+   _foCap.resize(n);
+   unsigned s = 0;
+   for (size_t i = 0; i < n; ++i){
+      _foStart[i] = s;
+      _foCap[i] = _foSize[i];
+      s += _foSize[i];
+      _foSize[i] = 0;
+   }
+   _foList.resize(s);
+   pool.run(T, [&](size_t k) {
+      size_t b, e; range(k, b, e);
+      for (size_t i = b; i < e; ++i)
+         for (unsigned j = 0, m = getFaninSize(i); j < m; ++j){
+            unsigned f = _fanin[2 * i + j] / 2;
+            unsigned slot = __atomic_fetch_add(&_foSize[f], 1, __ATOMIC_RELAXED);
+            _foList[_foStart[f] + slot] = 2 * i + _fanin[2 * i + j] % 2;
+         }
+   });
+   auto less = [this](unsigned a, unsigned b) {
+      if (a / 2 != b / 2) return a / 2 < b / 2;
+      return a != b && a % 2 == _fanin[a / 2 * 2] % 2;
+   };
+   // then the back indices: the first of two fanouts to the same gate is
+   // its first fanin
+   _foIdx.resize(2 * n);
+   pool.run(T, [&](size_t k) {
+      size_t b, e; range(k, b, e);
+      for (size_t i = b; i < e; ++i){
+         unsigned* v = &_foList[_foStart[i]];
+         if (_foSize[i] > 1) sort(v, v + _foSize[i], less);
+         for (unsigned x = 0; x < _foSize[i]; ++x){
+            unsigned g = v[x] / 2;
+            bool second = _fanin[2 * g] / 2 != i || (x && v[x - 1] / 2 == g);
+            _foIdx[2 * g + second] = x;
+         }
+      }
+   });
+}
+
+// Add "lit", fanin j of gate lit / 2, to the fanouts of "gid". A full
+// fanout slot is moved to the end of _foList with doubled capacity; the
+// old slot becomes garbage until the next buildFanout().
+void
+CirMgr::addFanout(unsigned gid, unsigned lit, unsigned j)
+{
+   if (_foSize[gid] == _foCap[gid]){
+      unsigned s = _foList.size(), c = _foCap[gid]? 2 * _foCap[gid]: 2;
+      _foList.resize(s + c);
+      for (unsigned i = 0; i < _foSize[gid]; ++i)
+         _foList[s + i] = _foList[_foStart[gid] + i];
+      _foStart[gid] = s;
+      _foCap[gid] = c;
+   }
+   _foIdx[lit / 2 * 2 + j] = _foSize[gid];
+   _foList[_foStart[gid] + _foSize[gid]++] = lit;
+}
+
+// Remove gate "id" from the fanouts of "gid" in O(1) through the back
+// index of the edge; the last fanout takes its place. If both fanins of
+// "id" are "gid", the one earlier in the slot goes first.
+void
+CirMgr::deleteFanout(unsigned gid, unsigned id)
+{
+   unsigned* e = &_foIdx[2 * id];
+   unsigned j = _fanin[2 * id] / 2 == gid? 0: 1;
+   if (!j && getFaninSize(id) == 2 && _fanin[2 * id + 1] / 2 == gid && e[1] < e[0])
+      j = 1;
+   assert(_fanin[2 * id + j] / 2 == gid && e[j] < _foSize[gid]);
+   unsigned* v = &_foList[_foStart[gid]];
+   unsigned x = e[j], last = --_foSize[gid];
+   e[j] = NO_FANOUT;
+   if (x == last) return;
+   unsigned* m = &_foIdx[v[last] / 2 * 2];
+   m[_fanin[v[last] / 2 * 2] / 2 == gid && m[0] == last? 0: 1] = x;
+   v[x] = v[last];
+}
+
+// Replace the first fanin of "gid" driven by gate "id" with "lit" and
+// return which fanin it was
+unsigned
+CirMgr::replaceFanin(unsigned gid, unsigned id, unsigned lit)
+{
+   unsigned* v = &_fanin[2 * gid];
+   if (v[0] / 2 == id) { v[0] = lit; return 0; }
+   assert(v[1] / 2 == id); v[1] = lit; return 1;
+}
+
+void
+CirMgr::removeGate(unsigned gid)
+{
+   _type[gid] = NO_GATE;
+   _foSize[gid] = 0;
+   if (gid < _symOf.size()) _symOf[gid] = 0;
+}
+
+// All the names live in one growing buffer, so a netlist with symbols
+// costs a couple of allocations and no per-name heap blocks. A redefined
+// name only moves the index; the old text stays until the next read.
+void
+CirMgr::setSymbol(unsigned gid, const char* s, size_t n)
+{
+   if (gid >= _symOf.size()) _symOf.resize(std::max(size_t(gid) + 1, _type.size()), 0);
+   _symOf[gid] = _symText.size() + 1;
+   _symText.insert(_symText.end(), s, s + n);
+   _symText.push_back('\0');
+}
+
+// Next white-space delimited token, as "fin >> str" would read it
+static inline size_t
+readToken(const char*& tok)
+{
+   while (cur < fend && isspace((unsigned char)*cur)) ++cur;
+   for (tok = cur; cur < fend && !isspace((unsigned char)*cur); ++cur) ;
+   return cur - tok;
+}
+
+// myStr2Int() on a token, without a string temporary
+static inline bool
+tokenToInt(const char* s, size_t n, int& num)
+{
+   num = 0;
+   size_t i = 0;
+   int sign = 1;
+   if (n && s[0] == '-') { sign = -1; i = 1; }
+   if (i == n) return false;
+   for (; i < n; ++i) {
+      if (!isdigit((unsigned char)s[i])) return false;
+      num = num * 10 + int(s[i] - '0');
+   }
+   num *= sign;
+   return true;
+}
+
+// One delta of a binary AND gate: 7 bits per byte, low bits first, the
+// high bit set on all bytes but the last. False if the file ends first.
+static inline bool
+readDelta(unsigned& x)
+{
+   x = 0;
+   for (unsigned i = 0; cur < fend; i += 7) {
+      unsigned char c = *cur++;
+      if (i < 32) x |= unsigned(c & 0x7f) << i;
+      if (!(c & 0x80)) return true;
+   }
+   return false;
+}
+
+// Skip white space and read an unsigned number at p (no checks, for
+// readNoError)
+static inline unsigned
+scanNum(const char*& p)
+{
+   while (p < fend && (unsigned char)*p <= ' ') ++p;
+   unsigned n = 0;
+   for (; p < fend && (unsigned)(*p - '0') < 10; ++p)
+      n = n * 10 + unsigned(*p - '0');
+   return n;
+}
+
+static inline unsigned readNum() { return scanNum(cur); }
+
+static CirParseError
+checkNoDel(const char* errStr){
+   int d = peekChar();
    if (d == ' ') return EXTRA_SPACE;
    if ((errInt = d) == '\t') return ILLEGAL_WSPACE;
    if (d == '\n' || d == '\r' || d == EOF){
@@ -147,33 +528,37 @@ CirParseError checkNoDel(ifstream& fin, string errStr){
    return DUMMY_END;
 }
 
-CirParseError eatOneSpace(ifstream& fin, string errStr){
-   int d = fin.peek();
+static CirParseError
+eatOneSpace(const char* errStr){
+   int d = peekChar();
    if ((errInt = d) == '\t')
       return ILLEGAL_WSPACE;
    if (d == '\n' || d == '\r'){
       errMsg = errStr;
       return MISSING_NUM;
    }
-   fin.get(); ++colNo;
+   getChar(); ++colNo;
    return DUMMY_END;
 }
 
-CirParseError eatOneNum(ifstream& fin, string errStr, string& buff, int& d){
+static CirParseError
+eatOneNum(const char* errStr, size_t& len, int& d){
    CirParseError err;
-   if ((err = eatOneSpace(fin, errStr)) != DUMMY_END) return err;
-   if ((err = checkNoDel(fin, errStr))  != DUMMY_END) return err;
-   fin >> buff;
-   if (!myStr2Int(buff, d) || d < 0){
-      errMsg = errStr + "(" + buff + ")";
+   const char* tok;
+   if ((err = eatOneSpace(errStr)) != DUMMY_END) return err;
+   if ((err = checkNoDel(errStr))  != DUMMY_END) return err;
+   len = readToken(tok);
+   if (!tokenToInt(tok, len, d) || d < 0){
+      errMsg = string(errStr) + "(" + string(tok, len) + ")";
       return ILLEGAL_NUM;
    }
    return DUMMY_END;
 }
 
-bool checkStr(string& s){
-   for (size_t i = 0; i < s.length(); ++i)
-      if (!isprint(s[i])){
+static bool
+checkStr(const char* s, size_t n){
+   for (size_t i = 0; i < n; ++i)
+      if (!isprint((unsigned char)s[i])){
           errInt = s[i];
           return true;
       }
@@ -181,20 +566,22 @@ bool checkStr(string& s){
 }
 
 CirParseError
-CirMgr::readFirstLine(ifstream& fin){
+CirMgr::readFirstLine(){
    CirParseError err;
-   int d = fin.peek();
-   string buff;
+   int d = peekChar();
+   const char* tok;
+   size_t len;
    if (d == EOF || d == '\n' || d == '\r'){
       errMsg = "aag";
       return MISSING_IDENTIFIER;
    }
-   if ((err = checkNoDel(fin, "")) != DUMMY_END) return err;
+   if ((err = checkNoDel("")) != DUMMY_END) return err;
 
-   // input "aag"
-   fin >> buff;
-   if ((errMsg = buff) != "aag"){
-      if (errMsg.length() > 3 && isdigit(errMsg[3])){
+   // input "aag" or "aig"
+   len = readToken(tok);
+   isBinary = (errMsg = string(tok, len)) == "aig";
+   if (errMsg != "aag" && !isBinary){
+      if (len > 3 && isdigit((unsigned char)tok[3])){
           colNo += 3;
           return MISSING_SPACE;
       }
@@ -203,18 +590,18 @@ CirMgr::readFirstLine(ifstream& fin){
    colNo += 3;
 
    // input M
-   if ((err = eatOneNum(fin, "number of variables", buff, d)) != DUMMY_END) return err;
+   if ((err = eatOneNum("number of variables", len, d)) != DUMMY_END) return err;
    _M = (size_t)d;
-   colNo += buff.length();
+   colNo += len;
 
    // input I
-   if ((err = eatOneNum(fin, "number of PIs", buff, d)) != DUMMY_END) return err;
+   if ((err = eatOneNum("number of PIs", len, d)) != DUMMY_END) return err;
    _PIList.resize(d);
    _inputs.resize(d);
-   colNo += buff.length();
+   colNo += len;
 
    // input L
-   if ((err = eatOneNum(fin, "number of latches", buff, d)) != DUMMY_END) return err;
+   if ((err = eatOneNum("number of latches", len, d)) != DUMMY_END) return err;
    if (d != 0){
       errMsg = "latches";
       return ILLEGAL_NUM;
@@ -222,64 +609,75 @@ CirMgr::readFirstLine(ifstream& fin){
    colNo += 1;
 
    // input O
-   if ((err = eatOneNum(fin, "number of POs", buff, d)) != DUMMY_END) return err;
+   if ((err = eatOneNum("number of POs", len, d)) != DUMMY_END) return err;
    _POList.resize(d);
    _outputs.resize(d);
-   colNo += buff.length();
+   colNo += len;
 
    // input A
-   if ((err = eatOneNum(fin, "number of AIGs", buff, d)) != DUMMY_END) return err;
+   if ((err = eatOneNum("number of AIGs", len, d)) != DUMMY_END) return err;
    if (d + (int)_PIList.size() > (errInt = _M)){
       errMsg = "number of variables";
       return NUM_TOO_SMALL;
    }
+   if (isBinary && d + _PIList.size() < _M){
+      errMsg = "number of variables";
+      return NUM_TOO_BIG;
+   }
    _A = (size_t)d;
-   colNo += buff.length();
+   colNo += len;
 
-   d = fin.get();
+   d = getChar();
    if (d != '\n' && d != '\r') return MISSING_NEWLINE;
    ++lineNo; colNo = 0;
 
-   _gateList.resize(_M + _POList.size() + 1);
-   memset(&_gateList[0], 0, sizeof(_gateList[0]) * _gateList.size());
-   _gateList[0] = new CirCONSTGate(0, 0);
+   initGates(_M + _POList.size() + 1);
    
    return DUMMY_END;
 }
 
 CirParseError
-CirMgr::readPI(ifstream& fin){
+CirMgr::readPI(){
    CirParseError err;
-   string buff;
+   const char* tok;
+   size_t len;
    
+   if (isBinary){
+      // the PIs are 2, 4, ..., 2 * I and have no lines
+      for (size_t i = 0; i < _PIList.size(); ++i, ++lineNo){
+          setGate(i + 1, PI_GATE, lineNo + 1);
+          _PIList[i] = 2 * (i + 1);
+      }
+      return DUMMY_END;
+   }
    for (size_t i = 0; i < _PIList.size(); ++i){
-      int d = fin.peek();
+      int d = peekChar();
       if (d == EOF){
           errMsg = "PI";
           return MISSING_DEF;
       }
-      if ((err = checkNoDel(fin, "PI literal ID")) != DUMMY_END) return err;
-      fin >> buff;
-      errMsg = "PI literal ID(" + buff + ")";
-      if (myStr2Int(buff, d)){
-          errInt = d;
-          if (d == 0 || d == 1) return REDEF_CONST;
-          if (d > 0 && d % 2){
-              errMsg = "PI";
-              return CANNOT_INVERTED;
-          }
-          if (d > (int)_M * 2) return MAX_LIT_ID;
+      if ((err = checkNoDel("PI literal ID")) != DUMMY_END) return err;
+      len = readToken(tok);
+      if (!tokenToInt(tok, len, d) || d < 0){
+          errMsg = "PI literal ID(" + string(tok, len) + ")";
+          return ILLEGAL_NUM;
+      }
+      errInt = d;
+      if (d == 0 || d == 1) return REDEF_CONST;
+      if (d % 2){
+          errMsg = "PI";
+          return CANNOT_INVERTED;
       }
-      else return ILLEGAL_NUM;
-      if (_gateList[d / 2]){
-          errGate = _gateList[d / 2];
+      if (d > (int)_M * 2) return MAX_LIT_ID;
+      if (isGate(d / 2)){
+          errGate = getGate(d / 2);
           return REDEF_GATE;
       }
-      _gateList[d / 2] = new CirPIGate(d / 2, lineNo + 1);
+      setGate(d / 2, PI_GATE, lineNo + 1);
       _PIList[i] = d;
-      colNo += buff.length();
+      colNo += len;
 
-      d = fin.get();
+      d = getChar();
       if (d != '\n' && d != '\r') return MISSING_NEWLINE;
       lineNo++; colNo = 0;
    }
@@ -287,26 +685,29 @@ CirMgr::readPI(ifstream& fin){
 }
 
 CirParseError
-CirMgr::readPO(ifstream& fin){
+CirMgr::readPO(){
    CirParseError err;
-   string buff;
+   const char* tok;
+   size_t len;
 
    for (size_t i = 0; i < _POList.size(); ++i){
-      int d = fin.peek();
+      int d = peekChar();
       if (d == EOF){
           errMsg = "PO";
           return MISSING_DEF;
       }
-      if ((err = checkNoDel(fin, "PO literal ID")) != DUMMY_END) return err;
-      fin >> buff;
-      errMsg = "PO literal ID(" + buff + ")";
-      if (!myStr2Int(buff, d) || d < 0) return ILLEGAL_NUM;
+      if ((err = checkNoDel("PO literal ID")) != DUMMY_END) return err;
+      len = readToken(tok);
+      if (!tokenToInt(tok, len, d) || d < 0){
+          errMsg = "PO literal ID(" + string(tok, len) + ")";
+          return ILLEGAL_NUM;
+      }
       if ((errInt = d) > (int)_M * 2 + 1) return MAX_LIT_ID;
-      _gateList[_M + 1 + i] = new CirPOGate(_M + 1 + i, lineNo + 1);
+      setGate(_M + 1 + i, PO_GATE, lineNo + 1);
       _POList[i] = d;
-      colNo += buff.length();
+      colNo += len;
 
-      d = fin.get();
+      d = getChar();
       if (d != '\n' && d != '\r') return MISSING_NEWLINE;
       lineNo++; colNo = 0;
    }
@@ -314,59 +715,73 @@ CirMgr::readPO(ifstream& fin){
 }
 
 CirParseError
-CirMgr::readAIG(ifstream& fin){
+CirMgr::readAIG(){
    CirParseError err;
-   string buff;
+   const char* tok;
+   size_t len;
 
-   for (size_t i = 0; i < _A; ++i){
-      int d = fin.peek(), AIGid;
+   for (size_t i = 0; i < _A && isBinary; ++i){
+      unsigned lhs = 2 * (_PIList.size() + 1 + i), d0, d1;
+      if (!readDelta(d0) || !readDelta(d1)){
+          errMsg = "AIG";
+          return MISSING_DEF;
+      }
+      if (d0 == 0 || d0 > lhs || d1 > lhs - d0){
+          errInt = lhs;
+          errMsg = "AIG gate " + to_string(lhs) + " delta";
+          return ILLEGAL_NUM;
+      }
+      setGate(lhs / 2, AIG_GATE, lineNo + 1);
+      _fanin[lhs] = lhs - d0;
+      _fanin[lhs + 1] = lhs - d0 - d1;
+      ++lineNo;
+   }
+   for (size_t i = 0; i < _A && !isBinary; ++i){
+      int d = peekChar(), AIGid;
       if (d == EOF){
           errMsg = "AIG";
           return MISSING_DEF;
       }
-      if ((err = checkNoDel(fin, "AIG gate literal ID")) != DUMMY_END) return err;
-      fin >> buff;
-      errMsg = "AIG gate literal ID(" + buff + ")";
-      if (myStr2Int(buff, d)){
-          errInt = d;
-          if (d == 0 || d == 1) return REDEF_CONST;
-          if (d > 0 && d % 2){
-              errMsg = "AIG gate";
-              return CANNOT_INVERTED;
-          }
-          if (d > (int)_M * 2) return MAX_LIT_ID;
+      if ((err = checkNoDel("AIG gate literal ID")) != DUMMY_END) return err;
+      len = readToken(tok);
+      if (!tokenToInt(tok, len, d) || d < 0){
+          errMsg = "AIG gate literal ID(" + string(tok, len) + ")";
+          return ILLEGAL_NUM;
+      }
+      errInt = d;
+      if (d == 0 || d == 1) return REDEF_CONST;
+      if (d % 2){
+          errMsg = "AIG gate";
+          return CANNOT_INVERTED;
       }
-      else return ILLEGAL_NUM;
+      if (d > (int)_M * 2) return MAX_LIT_ID;
 
       // generate AIG
-      if ((errGate = _gateList[d / 2])){
-          if (_gateList[d / 2]->isUNDEF()){
-              CirGate* temp = _gateList[d / 2];
-              _gateList[d / 2] = _gateList[d / 2]->changeToAIG(lineNo + 1);
-              delete temp;
-          }
-          else return REDEF_GATE;
+      if (isGate(d / 2)){
+          errGate = getGate(d / 2);
+          if (_type[d / 2] != UNDEF_GATE) return REDEF_GATE;
       }
-      else _gateList[d / 2] = new CirAIGGate(d / 2, lineNo + 1);
+      setGate(d / 2, AIG_GATE, lineNo + 1);
       AIGid = d;
-      colNo += buff.length();
+      colNo += len;
 
       for (int j = 0; j < 2; ++j){
-          if (fin.get() != ' ') return MISSING_SPACE;
+          if (getChar() != ' ') return MISSING_SPACE;
           ++colNo;
 
-          if ((err = checkNoDel(fin, "AIG input literal ID")) != DUMMY_END) return err;
-          fin >> buff;
-          errMsg = "AIG input literal ID(" + buff + ")";
-          if (!myStr2Int(buff, d) || d < 0) return ILLEGAL_NUM;
+          if ((err = checkNoDel("AIG input literal ID")) != DUMMY_END) return err;
+          len = readToken(tok);
+          if (!tokenToInt(tok, len, d) || d < 0){
+             errMsg = "AIG input literal ID(" + string(tok, len) + ")";
+             return ILLEGAL_NUM;
+          }
           if ((errInt = d) > (int)_M * 2 + 1) return MAX_LIT_ID;
 
-          _gateList[AIGid / 2]->addFanin(d);
-          if (!_gateList[d / 2]) _gateList[d / 2] = new CirUNDEFGate(d / 2, 0);
-          _gateList[d / 2]->addFanout(AIGid + d % 2);
-          colNo += buff.length();
+          _fanin[AIGid + j] = d;
+          if (!isGate(d / 2)) setGate(d / 2, UNDEF_GATE, 0);
+          colNo += len;
       }
-      d = fin.get();
+      d = getChar();
       if (d != '\n' && d != '\r') return MISSING_NEWLINE;
       lineNo++; colNo = 0;
    }
@@ -374,19 +789,19 @@ CirMgr::readAIG(ifstream& fin){
    // connect PO with AIG
    for (size_t i = 0; i < _POList.size(); ++i){
       size_t po = _POList[i];
-      if (!_gateList[po / 2]) _gateList[po / 2] = new CirUNDEFGate(po / 2, 0);
-      _gateList[po / 2]->addFanout(2 * (_M + 1 + i) + po % 2);
-      _gateList[_M + 1 + i]->addFanin(po);
+      if (!isGate(po / 2)) setGate(po / 2, UNDEF_GATE, 0);
+      _fanin[2 * (_M + 1 + i)] = po;
    }
    return DUMMY_END;
 }
 
 CirParseError
-CirMgr::readSymbol(ifstream& fin){
+CirMgr::readSymbol(){
    CirParseError err;
-   string buff;
+   const char* tok;
+   size_t len;
 
-   int d = fin.get(), e;
+   int d = getChar(), e;
    char c;
    while (d != EOF && d != 'c'){
       c = d;
@@ -398,10 +813,12 @@ CirMgr::readSymbol(ifstream& fin){
       }
       ++colNo;
 
-      if ((err = checkNoDel(fin, "symbol index")) != DUMMY_END) return err;
-      fin >> buff;
-      errMsg = "symbol index(" + buff + ")";
-      if (!myStr2Int(buff, d) || d < 0) return ILLEGAL_NUM;
+      if ((err = checkNoDel("symbol index")) != DUMMY_END) return err;
+      len = readToken(tok);
+      if (!tokenToInt(tok, len, d) || d < 0){
+          errMsg = "symbol index(" + string(tok, len) + ")";
+          return ILLEGAL_NUM;
+      }
       if ((c == 'i' && d >= (int)_PIList.size()) ||
           (c == 'o' && d >= (int)_POList.size())){
           errInt = d;
@@ -409,114 +826,169 @@ CirMgr::readSymbol(ifstream& fin){
           errMsg = p + " index";
           return NUM_TOO_BIG;
       }
-      if ((c == 'i' && !_gateList[_PIList[d] / 2]->getSymbol().empty()) ||
-          (c == 'o' && !_gateList[_M + 1 + d]->getSymbol().empty())){
+      if ((c == 'i' && !getSymbol(_PIList[d] / 2).empty()) ||
+          (c == 'o' && !getSymbol(_M + 1 + d).empty())){
           errMsg = c + to_string(d);
           return REDEF_SYMBOLIC_NAME;
       }
-      colNo += buff.length();
+      colNo += len;
 
-      if (fin.get() != ' ') return MISSING_SPACE;
+      if (getChar() != ' ') return MISSING_SPACE;
       ++colNo;
 
-      e = fin.peek();
+      e = peekChar();
       if (e == '\n' || e == '\r' || e == EOF){
           errMsg = "symbol name";
           return MISSING_IDENTIFIER;
       }
-      fin.get(buf, 1024, '\n');
-      buff = buf;
-      if (checkStr(buff)) return ILLEGAL_SYMBOL_NAME;
-      if (c == 'i') _gateList[_PIList[d] / 2]->setSymbol(buff);
-      if (c == 'o') _gateList[_M + 1 + d]->setSymbol(buff);
-      colNo += buff.length();
+      // the rest of the line, at most MAX_SYMBOL_LEN characters
+      for (tok = cur; cur < fend && *cur != '\n' &&
+           cur - tok < MAX_SYMBOL_LEN; ++cur) ;
+      len = cur - tok;
+      if (checkStr(tok, len)) return ILLEGAL_SYMBOL_NAME;
+      setSymbol(c == 'i'? _PIList[d] / 2: _M + 1 + d, tok, len);
+      colNo += len;
 
-      d = fin.get();
+      d = getChar();
       if (d != '\n' && d != '\r') return MISSING_NEWLINE;
       ++lineNo; colNo = 0;
-      d = fin.get();
+      d = getChar();
    }
-   e = fin.get();
+   e = getChar();
    if (d == 'c' && e != '\n' && e != '\r') return MISSING_NEWLINE;
    return DUMMY_END;
 }
 
+// The _A lines "lhs rhs0 rhs1" of an ASCII file, starting at cur. A big
+// section is cut into one chunk per thread: a parallel newline count
+// gives the index of the first line starting in each chunk, then every
+// thread parses the lines that start in its chunk. The lines define
+// distinct gates, so the threads never write the same entry.
 void
-CirMgr::readNoError(ifstream& fin){
-   string buff;
+CirMgr::readAigLines(ThreadPool& pool)
+{
+   const size_t T = _A < PARALLEL_READ_MIN? 1: pool.size();
+   const char* base = cur;
+   const size_t len = fend - base;
+   vector<size_t> first(T + 1, 0);      // lines starting before chunk k
+   if (T > 1)
+      pool.run(T, [&](size_t k) {
+         first[k + 1] = std::count(base + len * k / T, base + len * (k + 1) / T, '\n');
+      });
+   for (size_t k = 0; k < T; ++k) first[k + 1] += first[k];
+   const char* symStart = fend;          // the line after the last AIG
+   auto parse = [&](size_t k) {
+      const char *p = base + len * k / T, *e = base + len * (k + 1) / T;
+      size_t i = first[k];
+      if (p != base && p[-1] != '\n'){   // skip to the first line start
+         p = (const char*)memchr(p, '\n', e - p);
+         if (!p) return;
+         ++p; ++i;
+      }
+      for (; p < e && i < _A; ++i){
+         unsigned t = scanNum(p);
+         _fanin[t] = scanNum(p);
+         _fanin[t + 1] = scanNum(p);
+         setGate(t / 2, AIG_GATE, lineNo + 1 + i);
+         p = (const char*)memchr(p, '\n', fend - p);
+         p = p? p + 1: fend;
+      }
+      if (i == _A && p < e) symStart = p;
+   };
+   if (T > 1) pool.run(T, parse);
+   else parse(0);
+   lineNo += _A;
+   cur = symStart;
+}
+
+// Trusts the file: numbers are scanned straight into the gate arrays
+void
+CirMgr::readNoError(ThreadPool& pool, unsigned nThreads){
+   const char* tok;
    size_t I, O, t;
-   fin >> buff >> _M >> I >> t >> O >> _A;  // read first line
-   _gateList.resize(_M + 1 + O);
-   memset(&_gateList[0], 0, sizeof(_gateList[0]) * _gateList.size());
-   _gateList[0] = new CirCONSTGate(0, 0);
+   isBinary = readToken(tok) == 3 && tok[1] == 'i';   // "aag" or "aig"
+   _M = readNum(); I = readNum(); readNum(); O = readNum(); _A = readNum();
+   if (_A >= PARALLEL_READ_MIN) pool.init(nThreads);
+   initGates(_M + 1 + O);
    _PIList.resize(I);
    _inputs.resize(I);
    _POList.resize(O);
    _outputs.resize(O);
    ++lineNo;
    for (size_t i = 0; i < I; ++i){  // read PI
-      fin >> t;
+      t = isBinary? 2 * (i + 1): readNum();
       _PIList[i] = t;
-      _gateList[t / 2] = new CirPIGate(t / 2, lineNo + 1);
+      setGate(t / 2, PI_GATE, lineNo + 1);
       ++lineNo;
    }
    for (size_t i = 0; i < O; ++i){  // read PO
-      fin >> t;
+      t = readNum();
       _POList[i] = t;
-      CirGate* po = new CirPOGate(_M + 1 + i, lineNo + 1);
-      po->addFanin(t);
-      _gateList[_M + 1 + i] = po;
+      setGate(_M + 1 + i, PO_GATE, lineNo + 1);
+      _fanin[2 * (_M + 1 + i)] = t;
       ++lineNo;
    }
-   for (size_t i = 0; i < _A; ++i){ // read AIG
-      fin >> t;
-      CirGate* g = new CirAIGGate(t / 2, lineNo + 1);
-      _gateList[t / 2] = g;
-      for (size_t j = 0; j < 2; ++j){
-          fin >> t; g->addFanin(t);
+   if (cur < fend && *cur == '\n') ++cur;
+   if (isBinary){
+      for (size_t i = 0; i < _A; ++i){ // read AIG
+         unsigned d0, d1;
+         t = 2 * (I + 1 + i);
+         readDelta(d0); readDelta(d1);
+         _fanin[t] = t - d0;
+         _fanin[t + 1] = t - d0 - d1;
+         setGate(t / 2, AIG_GATE, lineNo + 1);
+         ++lineNo;
       }
-      ++lineNo;
    }
-   for (size_t i = 0; i < _gateList.size(); ++i){ // connect all
-      if (!_gateList[i]) continue;
-      IdList& fanin = _gateList[i]->getFanin();
-      for (size_t j = 0; j < fanin.size(); ++j){
-          if (!_gateList[fanin[j] / 2])
-              _gateList[fanin[j] / 2] = new CirUNDEFGate(fanin[j] / 2, 0);
-          _gateList[fanin[j] / 2]->addFanout(i * 2 + fanin[j] % 2);
-      }
-   }
-   char c;
-   while (fin >> c){  // read symbol
+   else readAigLines(pool);
+   for (size_t i = 0; i < _type.size(); ++i) // connect all
+      for (unsigned j = 0, n = getFaninSize(i); j < n; ++j)
+          if (_type[_fanin[2 * i + j] / 2] == NO_GATE)
+              setGate(_fanin[2 * i + j] / 2, UNDEF_GATE, 0);
+   while (readToken(tok)){  // read symbol: "i0 name", "o0 name" or "c"
+      char c = *tok;
       if (c == 'c') return;
-      fin >> t >> buff;
-      if (c == 'i') _gateList[_PIList[t] / 2]->setSymbol(buff);
-      if (c == 'o') _gateList[_M + 1 + t]->setSymbol(buff);
+      cur = tok + 1;
+      t = readNum();
+      if (cur < fend && *cur == ' ') ++cur;
+      for (tok = cur; cur < fend && *cur != '\n' && *cur != '\r'; ++cur) ;
+      if (c == 'i') setSymbol(_PIList[t] / 2, tok, cur - tok);
+      if (c == 'o') setSymbol(_M + 1 + t, tok, cur - tok);
    }
 }
 
+// nThreads == 0: one thread per hardware thread. The threads are only
+// started for circuits with at least PARALLEL_READ_MIN AIGs.
 bool
-CirMgr::readCircuit(const string& fileName)
+CirMgr::readCircuit(const string& fileName, unsigned nThreads)
 {
-   CirGate::_mgr = this;
-   FecGrp::_mgr = this;
+   if (nThreads == 0) nThreads = thread::hardware_concurrency();
+   if (nThreads == 0) nThreads = 1;
+   ThreadPool pool;
+   initSimEngine();
    lineNo = colNo = 0;
-   ifstream fin(fileName.c_str());
-   if (!fin){
+   AigFile file;
+   if (!file.open(fileName)){
       cerr << "Cannot open design \"" + fileName + "\"\n";
       return false;
    }
+   cur = file.begin(); fend = file.end();
    
    #ifdef ERROR_HANDLE
    CirParseError err;
-   if ((err = readFirstLine(fin)) != DUMMY_END) return parseError(err);
-   if ((err = readPI(fin))        != DUMMY_END) return parseError(err);
-   if ((err = readPO(fin))        != DUMMY_END) return parseError(err);
-   if ((err = readAIG(fin))       != DUMMY_END) return parseError(err);
-   if ((err = readSymbol(fin))    != DUMMY_END) return parseError(err);
+   if ((err = readFirstLine()) != DUMMY_END) return parseError(err);
+   if (_A >= PARALLEL_READ_MIN) pool.init(nThreads);
+   if ((err = readPI())        != DUMMY_END) return parseError(err);
+   if ((err = readPO())        != DUMMY_END) return parseError(err);
+   if ((err = readAIG())       != DUMMY_END) return parseError(err);
+   if ((err = readSymbol())    != DUMMY_END) return parseError(err);
    #else
-   readNoError(fin);
+   readNoError(pool, nThreads);
    #endif // ERROR_HANDLE
+   cur = fend = 0;
+   buildFanout(pool);
+   _inputs.resize(_PIList.size() * _simWords);
+   _outputs.resize(_POList.size() * _simWords);
 
    setDFS();
    setFU(); // set gates with floating fanin & unused gates
@@ -526,63 +998,64 @@ CirMgr::readCircuit(const string& fileName)
 
 void
 CirMgr::setDFS(){
-   _gateList[0]->setPos(0);
+   _pos[0] = 0;
    ::count = 1;
    _DFSList.clear();
+   _simProg.clear();
+   _dfsRef.assign(_type.size(), 0);
    for (size_t i = 0; i < _POList.size(); i++)
-      findNonFloating(_gateList[_M + 1 + i]);
-   CirGate::setGlobalRef();
+      findNonFloating(_M + 1 + i);
+   setGlobalRef();
 }
 
+// Drop the slots of the gates taken out of _DFSList (set to 0, which is
+// never in the list) and renumber the others, keeping their order
 void
-CirMgr::findNonFloating(CirGate* gate){
-   if (!gate->isActive()){
-      gate->setRef();
-      IdList v = gate->getFanin();
-      for (size_t i = 0; i < v.size(); i++)
-          findNonFloating(_gateList[v[i] / 2]);
-      if (gate->isAig()){
-          gate->setPos(::count++);
-          _DFSList.push_back(gate->getId());
+CirMgr::compactDFS(){
+   size_t n = 0;
+   for (size_t i = 0; i < _DFSList.size(); ++i)
+      if (_DFSList[i]){
+         _DFSList[n++] = _DFSList[i];
+         _pos[_DFSList[i]] = n;
       }
-   }
+   _DFSList.resize(n);
+   _simProg.clear();
+}
+
+void
+CirMgr::findNonFloating(unsigned gid){
+   if (isActive(gid)) return;
+   setRef(gid);
+   faninDFS(_dfsStack, gid,
+      [this](unsigned, unsigned f) {
+         if (isActive(f / 2)) return false;
+         setRef(f / 2); return true;
+      },
+      [this](unsigned g) {
+         for (unsigned i = 0, n = getFaninSize(g); i < n; ++i)
+            ++_dfsRef[_fanin[2 * g + i] / 2];
+         if (_type[g] == AIG_GATE){
+            _pos[g] = ::count++;
+            _DFSList.push_back(g);
+         }
+      });
 }
 
 void
 CirMgr::setFU(){
    _floatFaninList.clear(); _unusedList.clear();
-   for (size_t i = 1; i < _gateList.size(); ++i){
-      if (_gateList[i]){
-        IdList fanin = _gateList[i]->getFanin(), fanout = _gateList[i]->getFanout();
-        for (size_t j = 0; j < fanin.size(); ++j)
-          if (_gateList[fanin[j] / 2]->isUNDEF())
+   for (unsigned i = 1; i < _type.size(); ++i){
+      if (isGate(i)){
+        for (unsigned j = 0, n = getFaninSize(i); j < n; ++j)
+          if (_type[_fanin[2 * i + j] / 2] == UNDEF_GATE)
             { _floatFaninList.push_back(i); break; }
-        if (!_gateList[i]->isPO() && fanout.empty())
+        if (_type[i] != PO_GATE && !_foSize[i])
             _unusedList.push_back(i);
       }
    }
 }
 
 
-void
-CirMgr::removeNotInDFSfromFECs()
-{
-   _gateList[0]->setPos(0);
-   ::count = 1;
-   _DFSList.clear();
-   for (size_t i = 0; i < _POList.size(); i++)
-      findNonFloating(_gateList[_M + 1 + i]);
-   for (size_t i = 0; i < _PIList.size(); ++i)
-      _gateList[_PIList[i] / 2]->setRef();
-   for (size_t i = 1; i <= _M; ++i)
-      if (_gateList[i] && !_gateList[i]->isActive())
-          if (_fecFriends.find(i) != _fecFriends.end()){
-            _fecFriends[i]->erase(i);
-            _fecFriends.erase(i);
-         }
-   CirGate::setGlobalRef();
-}
-
 /**********************************************************/
 /*   class CirMgr member functions for circuit printing   */
 /**********************************************************/
@@ -614,8 +1087,8 @@ CirMgr::printNetlist() const
    ::count = 0;
    cout << endl;
    for (size_t i = 0; i < _POList.size(); ++i)
-      postorder(_gateList[_M + 1 + i]);
-   CirGate::setGlobalRef();
+      postorder(_M + 1 + i);
+   setGlobalRef();
 }
 
 void
@@ -656,143 +1129,179 @@ CirMgr::printFloatGates() const
 void
 CirMgr::printFECPairs()
 {
-   for (size_t i = 0; i < _fecGrps.size(); ++i) _fecGrps[i]->sort();
-   sort(_fecGrps.begin(), _fecGrps.end(), FecCompare());
-   for (size_t i = 0; i < _fecGrps.size(); ++i)
-      cout << '[' << i << ']' << (*_fecGrps[i]);
+   IdList cls;
+   for (unsigned c = 0; c < _fecStart.size(); ++c){
+      if (!_fecSize[c]) continue;
+      unsigned* p = &_fecLits[_fecStart[c]];
+      sort(p, p + _fecSize[c]);
+      for (unsigned i = 0; i < _fecSize[c]; ++i) _fecIdx[p[i] / 2] = _fecStart[c] + i;
+      cls.push_back(c);
+   }
+   sort(cls.begin(), cls.end(), [this](unsigned a, unsigned b)
+      { return _fecLits[_fecStart[a]] < _fecLits[_fecStart[b]]; });
+   for (size_t i = 0; i < cls.size(); ++i){
+      const unsigned* p = &_fecLits[_fecStart[cls[i]]];
+      cout << '[' << i << ']';
+      for (unsigned j = 0; j < _fecSize[cls[i]]; ++j)
+         cout << ' ' << (p[j] % 2 == p[0] % 2? "":"!") << p[j] / 2;
+      cout << endl;
+   }
 }
 
+// The other members of the class of gid, complemented relative to gid
 void
-CirMgr::writeAag(ostream& outfile) const
+CirMgr::printFecOf(unsigned gid) const
+{
+   unsigned c = _fecOf[gid];
+   if (c == NO_FEC) return;
+   IdList lits(&_fecLits[_fecStart[c]], &_fecLits[_fecStart[c]] + _fecSize[c]);
+   sort(lits.begin(), lits.end());
+   size_t r = 0;
+   for (size_t i = 0; i < lits.size(); ++i)
+      if (lits[i] / 2 == gid) { r = lits[i] % 2; break; }
+   for (size_t i = 0; i < lits.size(); ++i)
+      if (lits[i] / 2 != gid)
+         cout << ' ' << (lits[i] % 2 == r? "":"!") << lits[i] / 2;
+}
+
+bool
+CirMgr::writeAag(int fd, bool binary) const
 {  
-   outfile << "aag " << _M << ' ' << _PIList.size() << " 0 " 
-           << _POList.size() << ' ' << _DFSList.size() << endl;
-   for (size_t i = 0; i < _PIList.size(); ++i) outfile << _PIList[i] << endl;
-   for (size_t i = 0; i < _POList.size(); ++i) outfile << _POList[i] << endl;
-   for (size_t i = 0; i < _DFSList.size(); ++i){
-      outfile << _DFSList[i] * 2;
-      IdList v = _gateList[_DFSList[i]]->getFanin();
-      for (size_t j = 0; j < v.size(); ++j) outfile << ' ' << v[j];
-      outfile << endl;
+   AigWriter outfile(fd);
+   if (binary){
+      IdList pis(_PIList.size());
+      for (size_t i = 0; i < _PIList.size(); ++i) pis[i] = _PIList[i] / 2;
+      writeBinary(outfile, pis, _DFSList, _POList);
+   }
+   else {
+      outfile << "aag " << _M << ' ' << _PIList.size() << " 0 " 
+              << _POList.size() << ' ' << _DFSList.size() << '\n';
+      for (size_t i = 0; i < _PIList.size(); ++i) outfile << _PIList[i] << '\n';
+      for (size_t i = 0; i < _POList.size(); ++i) outfile << _POList[i] << '\n';
+      for (size_t i = 0; i < _DFSList.size(); ++i){
+         unsigned g = _DFSList[i];
+         outfile << g * 2 << ' ' << _fanin[2 * g] << ' ' << _fanin[2 * g + 1] << '\n';
+      }
+   }
+   if (!_symOf.empty()){
+      for (size_t i = 0; i < _PIList.size(); ++i)
+         writeSymbol(outfile, 'i', i, _PIList[i] / 2);
+      for (size_t i = 0; i < _POList.size(); ++i)
+         writeSymbol(outfile, 'o', i, _M + i + 1);
    }
-   for (size_t i = 0; i < _PIList.size(); ++i)
-      if (!_gateList[_PIList[i] / 2]->getSymbol().empty())
-          outfile << 'i' << i << ' ' << _gateList[_PIList[i] / 2]->getSymbol() << endl;
-   for (size_t i = 0; i < _POList.size(); ++i)
-      if (!_gateList[_M + i + 1]->getSymbol().empty())
-          outfile << 'o' << i << ' ' << _gateList[_M + i + 1]->getSymbol() << endl;
    outfile << "c\nAAG output by Pei-Wei (Perry) Chen\n";
+   return outfile.flush();
 }
 
 void 
-CirMgr::postorder(CirGate* gate) const
+CirMgr::postorder(unsigned gid) const
 {
-   IdList fanin = gate->getFanin();
-   for (size_t i = 0; i < fanin.size(); ++i){
-      int id = fanin[i] / 2;
-      if (!_gateList[id]->isActive() && 
-          !_gateList[id]->isUNDEF())
-          postorder(_gateList[id]);
-   }
-
-   cout << "[" << ::count << "] " << setw(4) << left << gate->getTypeStr() << gate->getId();
-   for (size_t i = 0; i < fanin.size(); ++i)
-      cout << ' ' << (_gateList[fanin[i] / 2]->isUNDEF()? "*":"") 
-           << (fanin[i] % 2? "!":"") << fanin[i] / 2;
-   if (!gate->getSymbol().empty()) cout << " (" << gate->getSymbol() << ")";
-   cout << endl;
-   gate->setRef();
-   ++::count;
+   faninDFS(_dfsStack, gid,
+      [this](unsigned, unsigned f) {
+         return !isActive(f / 2) && _type[f / 2] != UNDEF_GATE;
+      },
+      [this](unsigned g) {
+         cout << "[" << ::count << "] " << setw(4) << left << getGate(g).getTypeStr() << g;
+         for (unsigned i = 0, n = getFaninSize(g); i < n; ++i){
+            unsigned f = _fanin[2 * g + i];
+            cout << ' ' << (_type[f / 2] == UNDEF_GATE? "*":"")
+                 << (f % 2? "!":"") << f / 2;
+         }
+         if (symbolOf(g) && *symbolOf(g)) cout << " (" << symbolOf(g) << ")";
+         cout << endl;
+         setRef(g);
+         ++::count;
+      });
 }
 
-void
-CirMgr::writeGate(ostream& outfile, CirGate *g) const
+bool
+CirMgr::writeGate(int fd, unsigned g, bool binary) const
 {
+   AigWriter outfile(fd);
    writeAIG.clear();
    ::count = 0;
    errInt = 0;
    writeDFS(g);
-   outfile << "aag " << errInt << ' ' << ::count 
-           << " 0 1 " << writeAIG.size() << endl;
-   for (size_t i = 0; i < _PIList.size(); ++i){
-      if (_gateList[_PIList[i] / 2]->isActive())
-          outfile << _PIList[i] << endl;
+   if (binary){
+      IdList pis;
+      for (size_t i = 0; i < _PIList.size(); ++i)
+         if (isActive(_PIList[i] / 2)) pis.push_back(_PIList[i] / 2);
+      writeBinary(outfile, pis, writeAIG, IdList(1, g * 2));
    }
-   outfile << g->getId() * 2 << endl;
-   for (size_t i = 0; i < writeAIG.size(); ++i){
-      outfile << writeAIG[i] * 2;
-      IdList v = _gateList[writeAIG[i]]->getFanin();
-      for (size_t j = 0; j < v.size(); ++j) outfile << ' ' << v[j];
-      outfile << endl;
+   else {
+      outfile << "aag " << errInt << ' ' << ::count 
+              << " 0 1 " << writeAIG.size() << '\n';
+      for (size_t i = 0; i < _PIList.size(); ++i){
+         if (isActive(_PIList[i] / 2))
+             outfile << _PIList[i] << '\n';
+      }
+      outfile << g * 2 << '\n';
+      for (size_t i = 0; i < writeAIG.size(); ++i){
+         unsigned a = writeAIG[i];
+         outfile << a * 2 << ' ' << _fanin[2 * a] << ' ' << _fanin[2 * a + 1] << '\n';
+      }
    }
    ::count = 0;
    for (size_t i = 0; i < _PIList.size(); ++i){
-      CirGate* g = _gateList[_PIList[i] / 2];
-      if (g->isActive() && !g->getSymbol().empty())
-          outfile << 'i' << ::count++ << ' ' << g->getSymbol() << endl;
+      unsigned p = _PIList[i] / 2;
+      if (isActive(p) && writeSymbol(outfile, 'i', ::count, p)) ++::count;
    }
-   outfile << "o0 " << g->getId() << "\nc\n";
-   outfile << "Write gate (" << g->getId() << ") by Pei-Wei (Perry) Chen\n";
-   CirGate::setGlobalRef();
+   outfile << "o0 " << g << "\nc\n";
+   outfile << "Write gate (" << g << ") by Pei-Wei (Perry) Chen\n";
+   setGlobalRef();
+   return outfile.flush();
 }
 
-void
-CirMgr::writeDFS(CirGate* g) const
+// Symbol line "<kind><idx> <name>" of gate "gid", if it has a name
+bool
+CirMgr::writeSymbol(AigWriter& outfile, char kind, unsigned idx, unsigned gid) const
 {
-   if (g->isActive() || g->isCONST() || g->isUNDEF()) return;
-   if (g->getId() > errInt) errInt = g->getId();
-   if (g->isPI()) {
-      ++::count;
-      g->setRef(); return;
-   }
-   IdList& fanin = g->getFanin();
-   for (size_t i = 0; i < fanin.size(); ++i)
-      writeDFS(_gateList[fanin[i] / 2]);
-   writeAIG.push_back(g->getId());
-   g->setRef();
-}
-
-/*************************************/
-/*   class FecGrp member functions   */
-/*************************************/
-CirMgr* FecGrp::_mgr = cirMgr;
-
-void
-FecGrp::setFECs(FecHash& h) {
-   for (size_t i = 0; i < _data.size(); ++i)
-      h[_data[i] / 2] = this;
-   setBase();
-}
-
-void
-FecGrp::setBase() {
-   _base = _data[0];
-   for (size_t i = 1; i < _data.size(); ++i)
-      if (_mgr->getGate(_data[i] / 2)->getPos()
-          < _mgr->getGate(_base / 2)->getPos())
-          _base = _data[i];
+   const char* s = symbolOf(gid);
+   if (!s || !*s) return false;
+   outfile << kind << idx << ' ' << s << '\n';
+   return true;
 }
 
+// Binary AIGER: the gates "pis" become variables 1 ... I and "aigs" (in a
+// topological order) the variables I + 1 ... I + A, so an AIG is written as
+// two delta-encoded numbers. The format has no undefined literals; a
+// floating fanin is written as constant 0, the value simulation gives it.
 void
-FecGrp::erase(unsigned x) {
-   for (size_t i = 0; i < _data.size(); ++i){
-      if (_data[i] / 2 == x){
-          bool isBase = _data[i] == _base;
-          _data[i] = _data.back();
-          _data.pop_back();
-          if (isBase) setBase();
-          break;
-      }
+CirMgr::writeBinary(AigWriter& outfile, const IdList& pis, const IdList& aigs,
+                    const IdList& pos) const
+{
+   IdList var(_type.size(), 0);
+   for (size_t i = 0; i < pis.size(); ++i) var[pis[i]] = i + 1;
+   for (size_t i = 0; i < aigs.size(); ++i) var[aigs[i]] = pis.size() + 1 + i;
+   outfile << "aig " << pis.size() + aigs.size() << ' ' << pis.size() << " 0 "
+           << pos.size() << ' ' << aigs.size() << '\n';
+   for (size_t i = 0; i < pos.size(); ++i)
+      outfile << 2 * var[pos[i] / 2] + pos[i] % 2 << '\n';
+   for (size_t i = 0; i < aigs.size(); ++i){
+      unsigned g = aigs[i], lhs = 2 * var[g];
+      unsigned r0 = 2 * var[_fanin[2 * g] / 2] + _fanin[2 * g] % 2;
+      unsigned r1 = 2 * var[_fanin[2 * g + 1] / 2] + _fanin[2 * g + 1] % 2;
+      if (r0 < r1) swap(r0, r1);
+      outfile.delta(lhs - r0);
+      outfile.delta(r0 - r1);
    }
 }
 
 void
-FecGrp::printFECs(unsigned t) {
-   size_t r = 0;
-   ::sort(_data.begin(), _data.end());
-   for (size_t i = 0; i < _data.size(); ++i)
-      if (_data[i] / 2 == t){ r = _data[i] % 2; break; }
-   for (size_t i = 0; i < _data.size(); ++i)
-      if (_data[i] / 2 != t)
-          cout << ' ' << (_data[i] % 2 == r? "":"!") << _data[i] / 2;
-}
\ No newline at end of file
+CirMgr::writeDFS(unsigned g) const
+{
+   // PIs are counted and marked, AIGs are marked when entered and written
+   // in post-order
+   auto enter = [this](unsigned id) {
+      if (isActive(id) || _type[id] == CONST_GATE || _type[id] == UNDEF_GATE)
+         return false;
+      if ((int)id > errInt) errInt = id;
+      setRef(id);
+      if (_type[id] == PI_GATE) { ++::count; return false; }
+      return true;
+   };
+   if (enter(g))
+      faninDFS(_dfsStack, g,
+         [&enter](unsigned, unsigned f) { return enter(f / 2); },
+         [](unsigned a) { writeAIG.push_back(a); });
+}
@@ -14,6 +14,7 @@
 #include <fstream>
 #include <iostream>
 #include <utility>
+#include <climits>
 #include "util.h"
 
 using namespace std;
@@ -21,6 +22,7 @@ using namespace std;
 // TODO: Feel free to define your own classes, variables, or functions.
 
 #include "cirDef.h"
+#include "cirGate.h"
 
 extern CirMgr *cirMgr;
 
@@ -47,39 +49,59 @@ enum CirParseError {
    DUMMY_END
 };
 
-class FecGrp;
-typedef unordered_map<unsigned, FecGrp*> FecHash;
-typedef unordered_map<SimValue, FecGrp*, SimHasher> SimHash;
+#define NO_FEC  UINT_MAX        // CirMgr::_fecOf of a gate in no FEC class
+#define NO_FANOUT UINT_MAX      // CirMgr::_foIdx of a deleted fanin edge
 
 // TODO: Define your own data members and member functions
 class CirMgr
 {
 public:
    friend class CirGate;
-   CirMgr(): _isSimulated(false), _isFraiged(false) {}
-   ~CirMgr();
+   CirMgr(): _isSimulated(false), _isFraiged(false), _simLog(0),
+             _numFecs(0), _simWords(1), _simLast(0), _simKernel(0), _globalRef(1) {}
+   ~CirMgr() {}
 
    // Access functions
-   // return '0' if "gid" corresponds to an undefined gate.
-   CirGate* getGate(unsigned gid) const { return gid < _gateList.size()? _gateList[gid]:0; }
+   // return a null handle if "gid" does not correspond to any gate.
+   CirGate getGate(unsigned gid) const
+   { return isGate(gid)? CirGate(this, gid): CirGate(); }
+
+   // Packed AIG store, indexed by gate ID
+   bool isGate(unsigned gid) const
+   { return gid < _type.size() && _type[gid] != NO_GATE; }
+   GateType getType(unsigned gid) const { return GateType(_type[gid]); }
+   unsigned getFaninSize(unsigned gid) const
+   { return _type[gid] == AIG_GATE? 2: (_type[gid] == PO_GATE? 1: 0); }
+   unsigned getFanin(unsigned gid, unsigned i) const
+   { return _fanin[2 * gid + i]; }
+   unsigned getFanoutSize(unsigned gid) const { return _foSize[gid]; }
+   unsigned getFanout(unsigned gid, unsigned i) const
+   { return _foList[_foStart[gid] + i]; }
+   unsigned getPos(unsigned gid) const { return _pos[gid]; }
+   // first 64 patterns of the signature
+   SimValue getSimVal(unsigned gid) const { return _simVal[gid * _simWords]; }
+   // the word holding the last pattern simulated, as shown by CIRGate
+   SimValue getLastSimVal(unsigned gid) const
+   { return _simVal[gid * _simWords + _simLast]; }
 
    // Member functions about circuit construction
-   bool readCircuit(const string&);
+   bool readCircuit(const string&, unsigned nThreads = 0);
 
    // Member functions about circuit optimization
    void sweep();
    void optimize();
+   void compact();
 
    // Member functions about simulation
-   void randomSim();
+   void randomSim(unsigned nThreads = 1);
    void fileSim(ifstream&);
    void setSimLog(ofstream *logFile) { _simLog = logFile; }
-   void writeLog();
+   void writeLog(const size_t* v);
 
    // Member functions about fraig
    void strash();
    void printFEC() const;
-   void fraig();
+   void fraig(unsigned nThreads = 1, int effort = -1, bool circuit = false);
 
    // Member functions about circuit reporting
    void printSummary() const;
@@ -87,19 +109,17 @@ public:
    void printPIs() const;
    void printPOs() const;
    void printFloatGates() const;
-   void printNonFloating (ostream&, CirGate*) const;
    void printFECPairs();
-   void writeAag(ostream&) const;
-   void writeGate(ostream&, CirGate*) const;
+   bool writeAag(int fd, bool binary = false) const;
+   bool writeGate(int fd, unsigned, bool binary = false) const;
 
-   void postorder(CirGate*) const;
+   void postorder(unsigned) const;
 
 private:
    size_t          _M;
    size_t          _A;
    bool            _isSimulated;
    bool            _isFraiged;
-   GateList        _gateList;
    IdList          _PIList;            // stored in pos/neg
    IdList          _POList;            // stored in pos/neg
    IdList          _floatFaninList;    // stored in gateId
@@ -108,74 +128,144 @@ private:
    vector<size_t>  _inputs;
    vector<size_t>  _outputs;
    ofstream*       _simLog;
-   vector<FecGrp*> _fecGrps;
-   FecHash          _fecFriends;
-
-   void readNoError(ifstream&);
-   CirParseError readFirstLine(ifstream&);
-   CirParseError readPI(ifstream&);
-   CirParseError readPO(ifstream&);
-   CirParseError readAIG(ifstream&);
-   CirParseError readSymbol(ifstream&);
+
+   // FEC classes in one flat array: class c holds the literals
+   // _fecLits[_fecStart[c]] ... _fecLits[_fecStart[c]+_fecSize[c]-1].
+   // A class is split inside its own slice; a dissolved one has size 0.
+   IdList          _fecLits;
+   IdList          _fecStart;
+   IdList          _fecSize;
+   IdList          _fecBase;           // the literal first in _DFSList
+   IdList          _fecOf;             // class of each gate, or NO_FEC
+   IdList          _fecIdx;            // index of each gate in _fecLits
+   size_t          _numFecs;           // classes with 2+ members
+
+   // Packed AIG store (struct of arrays, indexed by gate ID)
+   vector<unsigned char> _type;        // GateType
+   IdList          _fanin;             // 2 literals per gate; PO uses [0]
+   IdList          _foStart;           // fanout table: literals of gate g are
+   IdList          _foSize;            //   _foList[_foStart[g]] ...
+   IdList          _foCap;             //   _foList[_foStart[g]+_foSize[g]-1]
+   IdList          _foList;
+   IdList          _foIdx;             // place of fanin edge 2*g+j in the
+                                       //   fanouts of its fanin
+   IdList          _lineNo;
+   IdList          _pos;               // position in _DFSList (1-based)
+   IdList          _dfsRef;            // fanins of _DFSList gates and POs
+   vector<size_t>  _simVal;            // _simWords words per gate
+   IdList          _simProg;           // compiled DFS order, see buildSimProg()
+   IdList          _tfoList;           // reSim(): gates to simulate again
+   IdList          _tfoProg;           //   and their program
+   IdList          _fecTouched;        // refineFECs(): classes to split again,
+   vector<bool>    _fecSeen;           //   flagged (all false between calls)
+   unsigned        _simWords;          // 64-bit words simulated per pass
+   unsigned        _simLast;           // word with the last pattern simulated
+   SimKernel       _simKernel;
+   mutable IdList  _ref;
+   mutable unsigned _globalRef;
+   IdList          _symOf;             // name of g at _symText[_symOf[g]-1]
+   vector<char>    _symText;           //   (0: none), NUL-terminated
+
+   // O(1) marking: gate is marked iff _ref[gid] == _globalRef
+   bool isActive(unsigned gid) const { return _ref[gid] == _globalRef; }
+   void setRef(unsigned gid) const { _ref[gid] = _globalRef; }
+   void setGlobalRef() const { ++_globalRef; }
+
+   // Post-order DFS from "root" without recursion. The fanins of a gate
+   // are tried in order and "enter(g, lit)" decides whether to go from "g"
+   // into its fanin "lit"; "visit(g)" is called after the last fanin of "g", i.e.
+   // in the order the recursive version would return from the gates.
+   // "stack" holds (gate, next fanin) pairs and is reused by the caller,
+   // so deep netlists cost neither call stack nor allocations.
+   mutable IdList  _dfsStack;
+   template <class Enter, class Visit>
+   void faninDFS(IdList& stack, unsigned root, Enter enter, Visit visit) const {
+      stack.clear();
+      stack.push_back(root); stack.push_back(0);
+      while (!stack.empty()) {
+         size_t top = stack.size() - 2;
+         unsigned g = stack[top], i = stack[top + 1];
+         if (i < getFaninSize(g)) {
+            ++stack[top + 1];
+            unsigned f = _fanin[2 * g + i];
+            if (enter(g, f)) { stack.push_back(f / 2); stack.push_back(0); }
+         }
+         else { stack.resize(top); visit(g); }
+      }
+   }
+
+   void initGates(size_t);
+   void setGate(unsigned, GateType, unsigned);
+   void buildFanout();
+   void buildFanout(ThreadPool&);
+   void buildFanoutParallel(ThreadPool&);
+   void addFanout(unsigned, unsigned, unsigned);
+   void deleteFanout(unsigned, unsigned);
+   unsigned replaceFanin(unsigned, unsigned, unsigned);
+   void removeGate(unsigned);
+   void setSymbol(unsigned, const char*, size_t);
+   const char* symbolOf(unsigned gid) const
+   { return gid < _symOf.size() && _symOf[gid]? &_symText[_symOf[gid] - 1]: 0; }
+   string getSymbol(unsigned gid) const
+   { const char* s = symbolOf(gid); return s? s: ""; }
+
+   void readNoError(ThreadPool&, unsigned);
+   void readAigLines(ThreadPool&);
+   CirParseError readFirstLine();
+   CirParseError readPI();
+   CirParseError readPO();
+   CirParseError readAIG();
+   CirParseError readSymbol();
    void setFU();
    void setDFS();
-   void findNonFloating(CirGate*);
-   void writeDFS(CirGate*) const;
+   void findNonFloating(unsigned);
+   void compactDFS();
+   void writeDFS(unsigned) const;
+   void writeBinary(AigWriter&, const IdList&, const IdList&, const IdList&) const;
+   bool writeSymbol(AigWriter&, char, unsigned, unsigned) const;
+
+   void sweepGate(unsigned);
+   void optimizeGate(unsigned);
+   void strashMerge(unsigned, unsigned);
+   void fraigMerge(unsigned, unsigned);
+   void checkPO(unsigned);
+
+   void initSimEngine();
+   void setRandomInput(size_t* v, unsigned gid);
+   void setRandomInput(unsigned gid) { setRandomInput(_simVal.data(), gid); }
 
    void resetFEC();
-   void simulate(bool);
+   void clearFECs();
+   void simulate(bool, unsigned nWords);
    void simulateCircuit(bool);
-   void findFECs();
-   void collectGrps(size_t, SimHash&);
-   void addNewGrps();
-   void setFecFriends();
-   void initSat(SatSolver& s, CirGate* base, CirGate* gate);
-   void genProofModel(SatSolver& s, CirGate* gate);
-   void reSim(const SatSolver& s);
+   void buildSimProg();
+   void findFECs(const size_t* v, unsigned nWords);
+   void refineFECs(const IdList& changed);
+   void refineFEC(unsigned c, const size_t* v, unsigned nWords);
+   void setFecBase(unsigned c);
+   void eraseFEC(unsigned gid);
+   void printFecOf(unsigned gid) const;
+   bool getFraigPair(unsigned gid, unsigned& base) const;
+   void solveFraig(FraigJob&, SatWorker&) const;
+   void genProofModel(SatWorker&, unsigned gate) const;
+   void setConeDecisions(SatWorker&, FraigJob&) const;
+   void minimizeCex(SatWorker&, FraigJob&, Var miter) const;
+   void cexCone(unsigned g, unsigned base, const IdList& model, IdList& cex) const;
+   bool cnfCut(const SatWorker&, unsigned g, IdList& cut) const;
+   void markCone(SatWorker&, const FraigJob&) const;
+   void solveCircuit(FraigJob&, SatWorker&) const;
+   SatResult csatSolve(SatWorker&, unsigned l0, unsigned l1, IdList& model) const;
+   unsigned char csatValue(const SatWorker&, unsigned lit) const;
+   bool csatAssign(SatWorker&, unsigned lit) const;
+   void csatUndo(SatWorker&, size_t t, size_t jf) const;
+   bool csatPropagate(SatWorker&) const;
+   bool csatImply(SatWorker&, unsigned g) const;
+   void addCexPattern(const IdList& model, size_t k, unsigned flip);
+   void reSim(IdList& pis, vector<bool>& isPI);
    void endFraig();
-   void removeNotInDFSfromFECs();
+   void removeFromDFS(unsigned);
 
    size_t rnGenSize_t() { return (size_t(rnGen(INT_MAX)) << 32) + rnGen(INT_MAX); }
 };
 
-
-class FecGrp
-{
-public:
-   friend class CirMgr;
-   FecGrp () {}
-   FecGrp (unsigned d):_base(d) { _data.push_back(d); }
-   unsigned& operator [] (size_t i) { return _data[i]; }
-   const unsigned& operator [] (size_t i) const { return _data[i]; }
-
-   void add(unsigned d) { _data.push_back(d); }
-   size_t size() const { return _data.size(); }
-   void sort() { ::sort(_data.begin(), _data.end()); }
-   bool isSingleton() { return _data.size() == 1; }
-   void printFECs (unsigned t) ;
-   void setFECs(FecHash& h);
-   void setBase();
-   unsigned getBase() const { return _base; }
-   void erase(unsigned x);
-
-   friend ostream& operator << (ostream& out, FecGrp& fg){
-      ::sort(fg._data.begin(), fg._data.end());
-      size_t d = fg[0] % 2;
-      for (size_t i = 0; i < fg.size(); ++i)
-         out << ' ' << (fg[i] % 2 == d? "":"!") << fg[i] / 2;
-      return out << endl;
-   }
-
-private:
-   IdList   _data;
-   unsigned _base;
-   static CirMgr* _mgr;
-};
-
-class FecCompare {
-public:
-   bool operator () (const FecGrp* g1, const FecGrp* g2) const
-   { return (*g1)[0] < (*g2)[0]; }
-};
-
 #endif // CIR_MGR_H
@@ -7,6 +7,7 @@
 ****************************************************************************/
 
 #include <cassert>
+#include <cstring>
 #include "cirMgr.h"
 #include "cirGate.h"
 #include "util.h"
@@ -36,15 +37,21 @@ CirMgr::sweep()
 {	
 	if (_unusedList.empty()) return;
 	// markDFS
-	_gateList[0]->setRef();
+	setRef(0);
 	for (size_t i = 0; i < _PIList.size(); ++i)
-		_gateList[_PIList[i] / 2]->setRef();
+		setRef(_PIList[i] / 2);
 	for (size_t i = 0; i < _DFSList.size(); ++i)
-		_gateList[_DFSList[i]]->setRef();
+		setRef(_DFSList[i]);
+	// floating fanins still used by the DFS list must survive as well
+	for (size_t i = 0; i < _POList.size(); ++i)
+		setRef(_POList[i] / 2);
+	for (size_t i = 0; i < _DFSList.size(); ++i)
+		for (unsigned j = 0; j < 2; ++j)
+			setRef(_fanin[2 * _DFSList[i] + j] / 2);
 
 	for (size_t i = 0; i < _unusedList.size(); ++i)
-		_gateList[_unusedList[i]]->sweep();
-	CirGate::setGlobalRef();
+		if (isGate(_unusedList[i])) sweepGate(_unusedList[i]);
+	setGlobalRef();
 	setFU();
 }
 
@@ -55,11 +62,138 @@ void
 CirMgr::optimize()
 {
 	for (size_t i = 0; i < _DFSList.size(); ++i)
-		_gateList[_DFSList[i]]->optimize();
+		optimizeGate(_DFSList[i]);
+	setDFS();
+	setFU();
+}
+
+// Renumber the gates densely: CONST 0, the PIs in order, then the AIG and
+// UNDEF gates in a topological order (the DFS list first, so its order is
+// kept, then the gates outside it) and the POs right after them. Every
+// per-gate array shrinks to the gates left after sweep / optimize / strash /
+// fraig; the fanout table, DFS list and floating / unused lists are rebuilt.
+// FEC classes are not kept, so it is not allowed on a simulated circuit.
+void
+CirMgr::compact()
+{
+	size_t n = _type.size(), O = _POList.size();
+	IdList newId(n, UINT_MAX);
+	unsigned m = 0;
+	newId[0] = m++; setRef(0);
+	for (size_t i = 0; i < _PIList.size(); ++i){
+		newId[_PIList[i] / 2] = m++;
+		setRef(_PIList[i] / 2);
+	}
+	auto number = [&](unsigned g) {
+		if (_type[g] == AIG_GATE || _type[g] == UNDEF_GATE) newId[g] = m++;
+	};
+	auto enter = [this](unsigned, unsigned f) {
+		if (isActive(f / 2)) return false;
+		setRef(f / 2); return true;
+	};
+	for (size_t i = 0; i < O; ++i) faninDFS(_dfsStack, _M + 1 + i, enter, number);
+	for (unsigned g = 1; g < n; ++g)
+		if (isGate(g) && !isActive(g) && _type[g] != PO_GATE)
+			{ setRef(g); faninDFS(_dfsStack, g, enter, number); }
+	setGlobalRef();
+	size_t M = m - 1, N = m + O, W = _simWords;
+	for (size_t i = 0; i < O; ++i) newId[_M + 1 + i] = m + i;
+	#ifdef LOG_DEBUG
+	cout << "Compacting: " << n << " IDs -> " << N << " IDs...\n";
+	#endif // LOG_DEBUG
+
+	vector<unsigned char> type(N, NO_GATE);
+	IdList fanin(2 * N, 0), lineNo(N, 0), symOf;
+	vector<size_t> simVal(N * W, 0);
+	if (!_symOf.empty()) symOf.assign(N, 0);
+	for (unsigned g = 0; g < n; ++g){
+		if (!isGate(g)) continue;
+		unsigned x = newId[g];
+		assert(x != UINT_MAX);
+		type[x] = _type[g];
+		for (unsigned j = 0, k = getFaninSize(g); j < k; ++j){
+			unsigned f = _fanin[2 * g + j];
+			assert(newId[f / 2] != UINT_MAX);
+			fanin[2 * x + j] = 2 * newId[f / 2] + f % 2;
+		}
+		lineNo[x] = _lineNo[g];
+		if (g < _symOf.size()) symOf[x] = _symOf[g];
+		memcpy(&simVal[x * W], &_simVal[g * W], sizeof(size_t) * W);
+	}
+	_type.swap(type); _fanin.swap(fanin); _lineNo.swap(lineNo);
+	_symOf.swap(symOf); _simVal.swap(simVal);
+	for (size_t i = 0; i < _PIList.size(); ++i) _PIList[i] = 2 * (i + 1);
+	for (size_t i = 0; i < O; ++i) _POList[i] = _fanin[2 * (M + 1 + i)];
+	_M = M;
+
+	// drop the old arrays first so that the rebuilt ones are exactly sized
+	IdList* derived[] = { &_foStart, &_foSize, &_foCap, &_foList, &_foIdx,
+	                      &_pos, &_dfsRef, &_ref, &_fecOf, &_fecIdx, &_simProg };
+	for (size_t i = 0; i < sizeof(derived) / sizeof(derived[0]); ++i)
+		IdList().swap(*derived[i]);
+	_pos.assign(N, 0);
+	_ref.assign(N, 0);
+	buildFanout();
 	setDFS();
 	setFU();
+	clearFECs();
 }
 
 /***************************************************/
 /*   Private member functions about optimization   */
 /***************************************************/
+void
+CirMgr::sweepGate(unsigned gid)
+{
+	if (isActive(gid)) return;
+	// detach from every fanin in order, removing the unmarked ones first
+	faninDFS(_dfsStack, gid,
+		[this](unsigned g, unsigned f) {
+			unsigned in = f / 2;
+			if (!isGate(in)) return false;
+			deleteFanout(in, g);
+			return !isActive(in);
+		},
+		[this](unsigned g) {
+			#ifdef LOG_DEBUG
+			cout << "Sweeping: " << getGate(g).getTypeStr() << "(" << g << ") removed...\n";
+			#endif // LOG_DEBUG
+			if (_type[g] == AIG_GATE) --_A;
+			removeGate(g);
+		});
+}
+
+void
+CirMgr::checkPO(unsigned gid)
+{
+	if (_type[gid] == PO_GATE) _POList[gid - _M - 1] = _fanin[2 * gid];
+}
+
+void
+CirMgr::optimizeGate(unsigned gid)
+{
+	unsigned f0 = _fanin[2 * gid], f1 = _fanin[2 * gid + 1];
+	unsigned to;   // literal that replaces this gate
+	// combine identical fanins
+	if (f0 == f1) to = f0;
+	// combine inverted fanins to CONST0
+	else if (f0 / 2 == f1 / 2) to = 0;
+	// convert to CONST0
+	else if (f0 == 0 || f1 == 0) to = 0;
+	// convert to the one not CONST1
+	else if (f0 == 1 || f1 == 1) to = f0 == 1? f1: f0;
+	else return;
+	deleteFanout(f0 / 2, gid);
+	deleteFanout(f1 / 2, gid);
+	for (unsigned i = 0; i < _foSize[gid]; ++i){
+		unsigned out = getFanout(gid, i), newfanin = to ^ (out % 2);
+		unsigned j = replaceFanin(out / 2, gid, newfanin);
+		addFanout(to / 2, out / 2 * 2 + newfanin % 2, j);
+		checkPO(out / 2);
+	}
+	#ifdef LOG_DEBUG
+	cout << "Simplifying: " << f0 << " merging " << f1 << "...\n";
+	#endif // LOG_DEBUG
+	--_A;
+	removeGate(gid);
+}
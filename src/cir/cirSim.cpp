@@ -12,9 +12,15 @@
 #include <cassert>
 #include <climits>
 #include <cmath>
+#include <cstring>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define CIR_SIM_X86
+#endif
 #include "cirMgr.h"
 #include "cirGate.h"
 #include "util.h"
+#include "myThreadPool.h"
 
 using namespace std;
 
@@ -24,12 +30,77 @@ using namespace std;
 /*******************************/
 /*   Global variable and enum  */
 /*******************************/
-vector<FecGrp*> newGrps;
 /**************************************/
 /*   Static varaibles and functions   */
 /**************************************/
 static size_t simCount;
 static size_t simLen;
+
+// Orders literals by signature: the first n of the W words of the gate,
+// complemented if the literal is odd. Literals of equal signature are not
+// told apart by the simulated patterns.
+struct SigLess
+{
+	SigLess(const size_t* v, unsigned W, unsigned n): _v(v), _W(W), _n(n) {}
+	bool operator () (unsigned a, unsigned b) const {
+		const size_t* x = _v + size_t(a / 2) * _W;
+		const size_t* y = _v + size_t(b / 2) * _W;
+		size_t ma = size_t(0) - a % 2, mb = size_t(0) - b % 2;
+		for (unsigned i = 0; i < _n; ++i)
+			if ((x[i] ^ ma) != (y[i] ^ mb)) return (x[i] ^ ma) < (y[i] ^ mb);
+		return false;
+	}
+	const size_t*  _v;
+	unsigned       _W;			// words per gate
+	unsigned       _n;			// words compared
+};
+
+// Simulation kernels: evaluate the triples [p, e) of the compiled program
+// on W words per gate. The complement mask of a literal is all ones iff
+// the literal is odd, so there is no branch inside the loop.
+template<unsigned W>
+static void
+simKernel(const unsigned* p, const unsigned* e, size_t* v)
+{
+	for (; p != e; p += 3){
+		size_t* o = v + size_t(p[0]) * W;
+		const size_t* a = v + size_t(p[1] / 2) * W;
+		const size_t* b = v + size_t(p[2] / 2) * W;
+		size_t ma = size_t(0) - p[1] % 2, mb = size_t(0) - p[2] % 2;
+		for (unsigned i = 0; i < W; ++i)
+			o[i] = (a[i] ^ ma) & (b[i] ^ mb);
+	}
+}
+
+#ifdef CIR_SIM_X86
+__attribute__((target("avx2"))) static void
+simKernelAVX2(const unsigned* p, const unsigned* e, size_t* v)
+{
+	__m256i* w = (__m256i*)v;
+	for (; p != e; p += 3){
+		__m256i ma = _mm256_set1_epi64x(-(long long)(p[1] % 2));
+		__m256i mb = _mm256_set1_epi64x(-(long long)(p[2] % 2));
+		__m256i a = _mm256_loadu_si256(w + p[1] / 2);
+		__m256i b = _mm256_loadu_si256(w + p[2] / 2);
+		_mm256_storeu_si256(w + p[0], _mm256_and_si256(
+			_mm256_xor_si256(a, ma), _mm256_xor_si256(b, mb)));
+	}
+}
+
+__attribute__((target("avx512f"))) static void
+simKernelAVX512(const unsigned* p, const unsigned* e, size_t* v)
+{
+	__m512i* w = (__m512i*)v;
+	for (; p != e; p += 3){
+		__m512i ma = _mm512_set1_epi64(-(long long)(p[1] % 2));
+		__m512i mb = _mm512_set1_epi64(-(long long)(p[2] % 2));
+		__m512i a = _mm512_loadu_si512(w + p[1] / 2);
+		__m512i b = _mm512_loadu_si512(w + p[2] / 2);
+		_mm512_storeu_si512(w + p[0], _mm512_and_si512(
+			_mm512_xor_si512(a, ma), _mm512_xor_si512(b, mb)));
+	}
+}
+#endif // CIR_SIM_X86
 /************************************************/
 /*   Public member functions about Simulation   */
 /************************************************/
@@ -37,11 +108,17 @@ static size_t simLen;
 #define INTERVAL 			100
 #define DIFFER_PERCENTAGE 	0.1
 
+// With nThreads > 1, every round simulates nThreads batches at once: batch 0
+// in _simVal and batch b in its own copy of the value array. The inputs of
+// all batches are drawn on this thread in batch order, and the FEC groups
+// are then refined batch by batch in the same order, so the result does
+// not depend on which thread simulated what. The last batch refined is
+// copied back to _simVal at the end.
 void
-CirMgr::randomSim()
+CirMgr::randomSim(unsigned nThreads)
 {
 	::simCount = 0;
-	::simLen = 64;
+	::simLen = 64 * _simWords;
 	if (_isFraiged) {
 		#ifdef LOG_DEBUG
 		cout << "0 patterns simulated\n";
@@ -51,22 +128,37 @@ CirMgr::randomSim()
 	if (!_isSimulated) resetFEC();
 	int failCount = 0, lastFecCount = 1;
 	size_t max = _PIList.size() < 64? size_t(1) << _PIList.size(): INT_MAX;
-	while (1) {
-		for (size_t i = 0; i < _PIList.size(); ++i)
-			_gateList[_PIList[i] / 2]->setSimVal(rnGenSize_t());
-		simulate(true);
-		++::simCount;
-		if (max < ::simCount * 64 || (::simCount % INTERVAL == 0 && 
-			abs(lastFecCount - (int)_fecGrps.size()) / 
-			(double)lastFecCount < DIFFER_PERCENTAGE)) break;
-		if (lastFecCount == (int)_fecGrps.size()){
-			if (++failCount == BREAK_COUNT || _fecGrps.empty()) break; }
-		else { lastFecCount = (int)_fecGrps.size(); failCount = 0; }
-		
-	}
-	setFecFriends();
+	if (nThreads == 0) nThreads = 1;
+	ThreadPool pool(nThreads);
+	vector<size_t> buf((nThreads - 1) * _simVal.size(), 0);
+	vector<size_t*> val(nThreads, _simVal.data());
+	for (unsigned b = 1; b < nThreads; ++b)
+		val[b] = buf.data() + (b - 1) * _simVal.size();
+	if (_simProg.empty()) buildSimProg();
+	const unsigned *p = _simProg.data(), *e = p + _simProg.size();
+	unsigned last = 0;
+	for (bool done = false; !done; ) {
+		for (unsigned b = 0; b < nThreads; ++b)
+			for (size_t i = 0; i < _PIList.size(); ++i)
+				setRandomInput(val[b], _PIList[i] / 2);
+		pool.run(nThreads, [&](size_t b) { _simKernel(p, e, val[b]); });
+		for (unsigned b = 0; b < nThreads && !done; ++b) {
+			last = b;
+			if (_simLog) writeLog(val[b]);
+			findFECs(val[b], _simWords);
+			++::simCount;
+			if (max < ::simCount * ::simLen || (::simCount % INTERVAL == 0 && 
+				abs(lastFecCount - (int)_numFecs) / 
+				(double)lastFecCount < DIFFER_PERCENTAGE)) done = true;
+			else if (lastFecCount == (int)_numFecs){
+				if (++failCount == BREAK_COUNT || !_numFecs) done = true; }
+			else { lastFecCount = (int)_numFecs; failCount = 0; }
+		}
+	}
+	if (last) memcpy(_simVal.data(), val[last], sizeof(size_t) * _simVal.size());
+	_simLast = _simWords - 1;
 	#ifdef LOG_DEBUG
-	cout << ::simCount * 64 << " patterns simulated\n";
+	cout << ::simCount * ::simLen << " patterns simulated\n";
 	#endif // LOG_DEBUG
 }
 
@@ -74,11 +166,12 @@ void
 CirMgr::fileSim(ifstream& patternFile)
 {
 	string temp, pattern;
+	const size_t n = 64 * _simWords;	// patterns per simulation pass
 	::simCount = 0;
-	::simLen = 64;
+	::simLen = n;
 	bool isValid = true;
 	if (!_isSimulated) resetFEC();
-	memset(&_inputs[0], 0, sizeof(_inputs[0]) * _inputs.size());
+	fill(_inputs.begin(), _inputs.end(), 0);
 	while (getline(patternFile, temp)){
 		myStrGetTok(temp, pattern);
 		if (pattern.length() == 0) continue;
@@ -98,43 +191,89 @@ CirMgr::fileSim(ifstream& patternFile)
 			}
 		}
 		if (!isValid) break;
-		for (size_t i = 0; i < _inputs.size(); ++i){
-			_inputs[i] <<= 1;
-			if (pattern[i] == '1') ++_inputs[i];
-		}		
+		// pattern k of a pass is bit (63 - k % 64) of word k / 64
+		size_t k = ::simCount % n, w = k / 64, m = size_t(1) << (63 - k % 64);
+		for (size_t i = 0; i < _PIList.size(); ++i)
+			if (pattern[i] == '1') _inputs[i * _simWords + w] |= m;
 		++::simCount;
-		if (::simCount % 64 == 0){
-			simulate(false);
-			memset(&_inputs[0], 0, sizeof(_inputs[0]) * _inputs.size());
+		if (::simCount % n == 0){
+			simulate(false, _simWords);
+			fill(_inputs.begin(), _inputs.end(), 0);
 		}
 	}
-	for (size_t i = 0; i < _inputs.size(); ++i) _inputs[i] <<= (64 - ::simCount % 64);
-	if ((::simLen = ::simCount % 64) != 0 && isValid) simulate(false);
-	if (::simCount < 64 && !isValid) _fecGrps.clear();
-	setFecFriends();
+	// the words past the last pattern are not compared: their all-0 bits
+	// are no pattern of the file
+	if ((::simLen = ::simCount % n) != 0 && isValid)
+		simulate(false, (::simLen + 63) / 64);
+	// the word of pattern simCount - 1 in its pass holds the same patterns
+	// for any _simWords; an invalid pattern drops the pass it started
+	_simLast = isValid && ::simCount? (::simCount - 1) % n / 64: _simWords - 1;
+	if (::simCount < n && !isValid) clearFECs();
 	#ifdef LOG_DEBUG
-	cout << (::simCount < 64 && !isValid? 0: ::simCount) << " patterns simulated\n";
+	cout << (::simCount < n && !isValid? 0: ::simCount) << " patterns simulated\n";
 	#endif // LOG_DEBUG
 }
 
 /*************************************************/
 /*   Private member functions about Simulation   */
 /*************************************************/
+// Pick the widest simulation word the CPU supports at run time:
+// 8 x 64 bits with AVX-512, 4 x 64 bits with AVX2, otherwise 1 x 64 bits.
+void
+CirMgr::initSimEngine()
+{
+	_simWords = 1; _simLast = 0; _simKernel = simKernel<1>;
+	#ifdef CIR_SIM_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f"))
+	{ _simWords = 8; _simKernel = simKernelAVX512; }
+	else if (__builtin_cpu_supports("avx2"))
+	{ _simWords = 4; _simKernel = simKernelAVX2; }
+	#endif // CIR_SIM_X86
+}
+
+void
+CirMgr::setRandomInput(size_t* v, unsigned gid)
+{
+	v += size_t(gid) * _simWords;
+	for (unsigned i = 0; i < _simWords; ++i) v[i] = rnGenSize_t();
+}
+
+// One class of CONST 0 and all the gates in _DFSList
 void
 CirMgr::resetFEC()
 {
-	_fecGrps.clear();
-	FecGrp* fec = new FecGrp(0);
-	for (size_t i = 0; i < _DFSList.size(); ++i)
-		fec->add(_DFSList[i] * 2);
-	_fecGrps.push_back(fec);
+	clearFECs();
+	if (_DFSList.empty()) return;
+	_fecLits.push_back(0);
+	_fecOf[0] = 0;
+	_fecIdx[0] = 0;
+	for (size_t i = 0; i < _DFSList.size(); ++i){
+		_fecIdx[_DFSList[i]] = _fecLits.size();
+		_fecLits.push_back(_DFSList[i] * 2);
+		_fecOf[_DFSList[i]] = 0;
+	}
+	_fecStart.push_back(0);
+	_fecSize.push_back(_fecLits.size());
+	_fecBase.push_back(0);
+	_numFecs = 1;
+}
+
+void
+CirMgr::clearFECs()
+{
+	_fecLits.clear(); _fecStart.clear(); _fecSize.clear(); _fecBase.clear();
+	_fecOf.assign(_type.size(), NO_FEC);
+	_fecIdx.resize(_type.size());
+	_numFecs = 0;
 }
 
+// Only the first nWords words of a signature are compared
 void
-CirMgr::simulate(bool inputSet)
+CirMgr::simulate(bool inputSet, unsigned nWords)
 {
 	simulateCircuit(inputSet);
-	findFECs();
+	findFECs(_simVal.data(), nWords);
 }
 
 void
@@ -142,105 +281,148 @@ CirMgr::simulateCircuit(bool inputSet)
 {
 	if (!inputSet)
 		for (size_t i = 0; i < _PIList.size(); ++i)
-			_gateList[_PIList[i] / 2]->setSimVal(_inputs[i]);
-	for (size_t i = 0; i < _DFSList.size(); ++i)
-		_gateList[_DFSList[i]]->simulate();
-	for (size_t i = 0; i < _POList.size(); ++i)
-		_gateList[_M + 1 + i]->simulate();
-	if (_simLog) writeLog();
+			memcpy(&_simVal[_PIList[i] / 2 * _simWords], &_inputs[i * _simWords],
+				sizeof(size_t) * _simWords);
+	if (_simProg.empty()) buildSimProg();
+	const unsigned* p = _simProg.data();
+	_simKernel(p, p + _simProg.size(), &_simVal[0]);
+	if (_simLog) writeLog(_simVal.data());
+}
+
+// Compile _DFSList (a topological order) followed by the POs into one
+// contiguous program of (gate ID, fanin literal, fanin literal) triples,
+// so that simulateCircuit() is a single branch-free loop.
+// A PO is compiled as "fanin & fanin".
+// The program is dropped whenever the DFS list is rebuilt.
+void
+CirMgr::buildSimProg()
+{
+	_simProg.resize(3 * (_DFSList.size() + _POList.size()));
+	unsigned* p = _simProg.data();
+	for (size_t i = 0; i < _DFSList.size(); ++i, p += 3){
+		unsigned g = _DFSList[i];
+		p[0] = g; p[1] = _fanin[2 * g]; p[2] = _fanin[2 * g + 1];
+	}
+	for (size_t i = 0; i < _POList.size(); ++i, p += 3){
+		p[0] = _M + 1 + i; p[1] = p[2] = _POList[i];
+	}
 }
 
 void
-CirMgr::writeLog(){
+CirMgr::writeLog(const size_t* v){
 	ofstream& log = *_simLog;
-	for (size_t i = 0; i < _POList.size(); ++i)
-		_outputs[i] = _gateList[_M + 1 + i]->getSimVal()();
-	size_t m = 0x8000000000000000;
-	for (size_t i = 0; i < ::simLen; ++i){
-		for (size_t j = 0; j < _inputs.size(); ++j)
-			log << (_inputs[j] & m? 1:0);
+	const unsigned W = _simWords;
+	for (size_t i = 0; i < _PIList.size(); ++i)
+		memcpy(&_inputs[i * W], v + _PIList[i] / 2 * W, sizeof(size_t) * W);
+	memcpy(_outputs.data(), v + (_M + 1) * W, sizeof(size_t) * W * _POList.size());
+	for (size_t k = 0; k < ::simLen; ++k){
+		size_t w = k / 64, m = size_t(1) << (63 - k % 64);
+		for (size_t j = 0; j < _PIList.size(); ++j)
+			log << (_inputs[j * W + w] & m? 1:0);
 		log << ' ';
 		for (size_t j = 0; j < _POList.size(); ++j)
-			log << (_outputs[j] & m? 1:0);
+			log << (_outputs[j * W + w] & m? 1:0);
 		log << endl;
-		m >>= 1;
 	}
 }
 
+// The first pass picks the phase of every literal so that its signature
+// starts with a 0 bit; a literal and the complement of another then end up
+// in the same class. Later passes keep the phases.
 void
-CirMgr::findFECs()
-{	
+CirMgr::findFECs(const size_t* v, unsigned nWords)
+{
 	if (!_isSimulated){
-		// for the first time
-		// divide all into grps by directly differing SimValue
-		// regardless of inverse
-		SimHash newFecGrps;
-		for (size_t i = 0;i < _fecGrps[0]->size(); ++i){
-			unsigned x = (*_fecGrps[0])[i];
-			SimValue sv = _gateList[x / 2]->getSimVal();
-			if (newFecGrps.find(sv) != newFecGrps.end())
-				newFecGrps[sv]->add(x);
-			else if (newFecGrps.find(!sv) != newFecGrps.end())
-				newFecGrps[!sv]->add(x + 1);
-			else newFecGrps[sv] = new FecGrp(x);
+		for (size_t i = 0; i < _fecLits.size(); ++i){
+			unsigned& x = _fecLits[i];
+			x = x / 2 * 2 + (v[size_t(x / 2) * _simWords] & 1);
 		}
-		collectGrps(0, newFecGrps);
-		addNewGrps();
 		_isSimulated = true;
-		return;
-	}
-	for (size_t i = 0; i < _fecGrps.size(); ++i){
-		SimHash newFecGrps;
-		for (int j = 0; j < (int)_fecGrps[i]->size(); ++j){
-			unsigned x = (*_fecGrps[i])[j];
-			SimValue sv = _gateList[x / 2]->getSimVal();
-			// x is odd, find inverse only
-			// if found, add x with x being odd (change x at collect phase)
-			// if not found, create new entry with simvalue inverted
-			if (x % 2){
-				if (newFecGrps.find(!sv) != newFecGrps.end())
-					newFecGrps[!sv]->add(x);
-				else newFecGrps[!sv] = new FecGrp(x);
-			}
-			// x is even, find directly
-			// if found, add x with x being even (no need to change)
-			// if not found, create new entry with simvalue un-inverted
-			else{
-				if (newFecGrps.find(sv) != newFecGrps.end())
-					newFecGrps[sv]->add(x);
-				else newFecGrps[sv] = new FecGrp(x);
-			}
-		}
-		collectGrps(i, newFecGrps);
 	}
-	addNewGrps();
+	for (unsigned c = 0, n = _fecStart.size(); c < n; ++c)
+		refineFEC(c, v, nWords);
 }
 
+// Split again only the classes with a member in "changed", the gates whose
+// values were just re-simulated; the other classes cannot have changed.
+// The work is proportional to "changed" and the classes it touches.
 void
-CirMgr::collectGrps(size_t i, SimHash& h)
+CirMgr::refineFECs(const IdList& changed)
 {
-	for (auto it = h.begin(); it != h.end(); ++it){
-		FecGrp* cand = it->second;
-		if (cand->isSingleton())
-		{ delete cand; continue; }
-		newGrps.push_back(cand);
+	IdList& touched = _fecTouched;
+	if (_fecSeen.size() < _fecStart.size()) _fecSeen.resize(_fecStart.size(), false);
+	touched.clear();
+	for (size_t i = 0; i < changed.size(); ++i){
+		unsigned c = _fecOf[changed[i]];
+		if (c != NO_FEC && !_fecSeen[c]) { _fecSeen[c] = true; touched.push_back(c); }
+	}
+	for (size_t i = 0; i < touched.size(); ++i){
+		_fecSeen[touched[i]] = false;
+		refineFEC(touched[i], _simVal.data(), _simWords);
 	}
-	delete _fecGrps[i];
 }
 
+// Sort the slice of class c by signature (the first nWords words of the
+// values "v"), then cut it into runs of equal signatures. The first run keeps the ID c, the others
+// get new IDs on the same slice, and a run of one gate leaves the classes.
 void
-CirMgr::addNewGrps()
+CirMgr::refineFEC(unsigned c, const size_t* v, unsigned nWords)
 {
-	_fecGrps.clear();
-//	for (size_t i = 0; i < newGrps.size(); ++i)
-//		_fecGrps.push_back(newGrps[i]);
-	newGrps.swap(_fecGrps);
+	unsigned* p = &_fecLits[_fecStart[c]];
+	const unsigned n = _fecSize[c];
+	if (n < 2) return;
+	SigLess less(v, _simWords, nWords);
+	::sort(p, p + n, less);
+	for (unsigned i = 0; i < n; ++i) _fecIdx[p[i] / 2] = _fecStart[c] + i;
+	if (!less(p[0], p[n - 1])) return;		// all equal
+	--_numFecs;
+	for (unsigned a = 0, b; a < n; a = b){
+		for (b = a + 1; b < n && !less(p[a], p[b]); ++b) ;
+		unsigned id = c;
+		if (b - a == 1){
+			_fecOf[p[a] / 2] = NO_FEC;
+			if (a == 0) _fecSize[c] = 0;
+			continue;
+		}
+		if (a == 0) _fecSize[c] = b;
+		else {
+			id = _fecStart.size();
+			_fecStart.push_back(_fecStart[c] + a);
+			_fecSize.push_back(b - a);
+			_fecBase.push_back(0);
+			for (unsigned k = a; k < b; ++k) _fecOf[p[k] / 2] = id;
+		}
+		setFecBase(id);
+		++_numFecs;
+	}
+}
+
+void
+CirMgr::setFecBase(unsigned c)
+{
+	const unsigned* p = &_fecLits[_fecStart[c]];
+	unsigned base = p[0];
+	for (unsigned i = 1; i < _fecSize[c]; ++i)
+		if (_pos[p[i] / 2] < _pos[base / 2]) base = p[i];
+	_fecBase[c] = base;
 }
 
+// Take gate gid out of its class, dissolving the class if one gate is left
 void
-CirMgr::setFecFriends()
+CirMgr::eraseFEC(unsigned gid)
 {
-	_fecFriends.clear();
-	for (size_t i = 0; i < _fecGrps.size(); ++i)
-		_fecGrps[i]->setFECs(_fecFriends);
+	unsigned c = _fecOf[gid];
+	if (c == NO_FEC) return;
+	_fecOf[gid] = NO_FEC;
+	unsigned* p = &_fecLits[_fecStart[c]];
+	unsigned& n = _fecSize[c];
+	unsigned i = _fecIdx[gid] - _fecStart[c];
+	swap(p[i], p[n - 1]);
+	_fecIdx[p[i] / 2] = _fecStart[c] + i;
+	if (--n == 1){
+		_fecOf[p[0] / 2] = NO_FEC;
+		n = 0;
+		--_numFecs;
+	}
+	else if (_fecBase[c] / 2 == gid) setFecBase(c);
 }
@@ -21,22 +21,35 @@ OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWA
 #include "Sort.h"
 #include <cmath>
 
-int effLimit = INT_MAX;
-
 //=================================================================================================
 // Helper functions:
 
 
-void removeWatch(vec<Clause*>& ws, Clause* elem)
+void removeWatch(vec<Watcher>& ws, CRef elem)
 {
     if (ws.size() == 0) return;     // (skip lists that are already cleared)
     int j = 0;
-    for (; ws[j] != elem  ; j++) assert(j < ws.size());
+    for (; ws[j].cref != elem; j++) assert(j < ws.size());
     for (; j < ws.size()-1; j++) ws[j] = ws[j+1];
     ws.pop();
 }
 
 
+// The x-th element of the Luby sequence 1 1 2 1 1 2 4 1 1 2 1 1 2 4 8 ... for y = 2 (in general
+// the sequence of the powers of y), used as the restart schedule.
+//
+static double luby(double y, int x)
+{
+    int size, seq;
+    for (size = 1, seq = 0; size < x+1; seq++, size = 2*size+1);
+    while (size-1 != x){
+        size = (size-1)>>1;
+        seq--;
+        x = x % size; }
+    return pow(y, seq);
+}
+
+
 //=================================================================================================
 // Operations on clauses:
 
@@ -106,7 +119,8 @@ void Solver::newClause(const vec<Lit>& ps_, bool learnt, ClauseId id , bool A)
 
     }else{
         // Allocate clause:
-        Clause* c   = Clause_new(learnt, ps, id);
+        CRef    cr  = ca.alloc(learnt, ps, id);
+        Clause& c   = ca[cr];
 
         if (learnt){
             // Put the second watch on the literal with highest decision level:
@@ -116,47 +130,57 @@ void Solver::newClause(const vec<Lit>& ps_, bool learnt, ClauseId id , bool A)
                 if (level[var(ps[i])] > max)
                     max   = level[var(ps[i])],
                     max_i = i;
-            (*c)[1]     = ps[max_i];
-            (*c)[max_i] = ps[1];
+            c[1]     = ps[max_i];
+            c[max_i] = ps[1];
 
             // Bumping:
             claBumpActivity(c); // (newly learnt clauses should be considered active)
 
             // Enqueue asserting literal:
-            check(enqueue((*c)[0], c));
+            check(enqueue(c[0], cr));
 
             // Store clause:
-            watches[index(~(*c)[0])].push(c);
-            watches[index(~(*c)[1])].push(c);
-            learnts.push(c);
-            stats.learnts_literals += c->size();
+            attach(cr);
+            learnts.push(cr);
+            stats.learnts_literals += c.size();
 
         }else{
             // Store clause:
-            watches[index(~(*c)[0])].push(c);
-            watches[index(~(*c)[1])].push(c);
-            clauses.push(c);
-            stats.clauses_literals += c->size();
+            attach(cr);
+            clauses.push(cr);
+            stats.clauses_literals += c.size();
         }
     }
 }
 
 
+// Adds a clause to the watcher lists of its first two literals. Binary clauses go to 'bin_watches'.
+//
+void Solver::attach(CRef cr)
+{
+    const Clause&       c  = ca[cr];
+    vec<vec<Watcher> >& ws = c.size() == 2 ? bin_watches : watches;
+    ws[index(~c[0])].push(Watcher(cr, c[1]));
+    ws[index(~c[1])].push(Watcher(cr, c[0]));
+}
+
+
 // Disposes a clauses and removes it from watcher lists. NOTE! Low-level; does NOT change the 'clauses' and 'learnts' vector.
+// The memory is only given back by the next 'garbageCollect()'.
 //
-void Solver::remove(Clause* c, bool just_dealloc)
+void Solver::remove(CRef cr)
 {
-    if (!just_dealloc){
-        removeWatch(watches[index(~(*c)[0])], c),
-        removeWatch(watches[index(~(*c)[1])], c);
+    const Clause&       c  = ca[cr];
+    vec<vec<Watcher> >& ws = c.size() == 2 ? bin_watches : watches;
+    removeWatch(ws[index(~c[0])], cr),
+    removeWatch(ws[index(~c[1])], cr);
 
-        if (c->learnt()) stats.learnts_literals -= c->size();
-        else             stats.clauses_literals -= c->size();
+    if (c.learnt()) stats.learnts_literals -= c.size();
+    else            stats.clauses_literals -= c.size();
 
-        if (proof != NULL) proof->deleted(c->id());
-    }
+    if (proof != NULL) proof->deleted(c.id());
 
-    xfree(c);
+    ca.free(cr);
 }
 
 
@@ -164,11 +188,11 @@ void Solver::remove(Clause* c, bool just_dealloc)
 // the clause is binary and satisfied, in which case the first literal is true)
 // Returns True if clause is satisfied (will be removed), False otherwise.
 //
-bool Solver::simplify(Clause* c) const
+bool Solver::simplify(const Clause& c) const
 {
     assert(decisionLevel() == 0);
-    for (int i = 0; i < c->size(); i++){
-        if (value((*c)[i]) == l_True)
+    for (int i = 0; i < c.size(); i++){
+        if (value(c[i]) == l_True)
             return true;
     }
     return false;
@@ -179,21 +203,27 @@ bool Solver::simplify(Clause* c) const
 // Minor methods:
 
 
-// Creates a new SAT variable in the solver. If 'decision_var' is cleared, variable will not be
-// used as a decision variable (NOTE! This has effects on the meaning of a SATISFIABLE result).
+// Creates a new SAT variable in the solver. It is a decision variable until 'setDecisionVar()'
+// clears that. (NOTE! A SATISFIABLE result then only assigns the decision variables and what
+// they imply; the model value of the other variables may be 'l_Undef'.)
 //
 Var Solver::newVar() {
     int     index;
     index = nVars();
     watches     .push();          // (list for positive literal)
     watches     .push();          // (list for negative literal)
-    reason      .push(NULL);
+    bin_watches .push();
+    bin_watches .push();
+    reason      .push(CRef_Undef);
     assigns     .push(toInt(l_Undef));
     level       .push(-1);
     trail_pos   .push(-1);
     activity    .push(0);
     order       .newVar();
     analyze_seen.push(0);
+    polarity    .push(1);
+    decision    .push(1);
+    lbd_seen    .push(0);
     if (proof != NULL) unit_id.push(ClauseId_NULL);
     return index; }
 
@@ -210,7 +240,8 @@ void Solver::cancelUntil(int level) {
         for (int c = trail.size()-1; c >= trail_lim[level]; c--){
             Var     x  = var(trail[c]);
             assigns[x] = toInt(l_Undef);
-            reason [x] = NULL;
+            reason [x] = CRef_Undef;
+            polarity[x] = sign(trail[c]);
             order.undo(x); }
         trail.shrink(trail.size() - trail_lim[level]);
         trail_lim.shrink(trail_lim.size() - level);
@@ -221,13 +252,30 @@ void Solver::cancelUntil(int level) {
 // Major methods:
 
 
+// Number of distinct decision levels among the (assigned) literals of 'c'.
+//
+template<class C>
+int Solver::computeLbd(const C& c)
+{
+    int n = 0;
+    if (++lbd_stamp == 0){  // (wrapped around)
+        for (int i = 0; i < lbd_seen.size(); i++) lbd_seen[i] = 0;
+        lbd_stamp = 1; }
+    for (int i = 0; i < c.size(); i++){
+        int l = level[var(c[i])];
+        if (lbd_seen[l] != lbd_stamp) lbd_seen[l] = lbd_stamp, n++; }
+    return n;
+}
+
+
 /*_________________________________________________________________________________________________
 |
-|  analyze : (confl : Clause*) (out_learnt : vec<Lit>&) (out_btlevel : int&)  ->  [void]
+|  analyze : (confl : CRef) (out_learnt : vec<Lit>&) (out_btlevel : int&) (out_lbd : int&)  ->  [void]
 |  
 |  Description:
-|    Analyze conflict and produce a reason clause ('out_learnt') and a backtracking level
-|    ('out_btlevel').
+|    Analyze conflict and produce a reason clause ('out_learnt'), a backtracking level
+|    ('out_btlevel') and the LBD of the reason clause ('out_lbd'). The learnt clauses met on the
+|    way are marked as used, and their LBD is lowered if it has improved.
 |  
 |    Pre-conditions:
 |      * 'out_learnt' is assumed to be cleared.
@@ -244,7 +292,7 @@ public:
     lastToFirst_lt(const vec<int>& t) : trail_pos(t) {}
     bool operator () (Lit p, Lit q) { return trail_pos[var(p)] > trail_pos[var(q)]; }
 };
-void Solver::analyze(Clause* confl, vec<Lit>& out_learnt, int& out_btlevel)
+void Solver::analyze(CRef confl, vec<Lit>& out_learnt, int& out_btlevel, int& out_lbd)
 {
     vec<char>&     seen  = analyze_seen;
     int            pathC = 0;
@@ -252,16 +300,20 @@ void Solver::analyze(Clause* confl, vec<Lit>& out_learnt, int& out_btlevel)
 
     // Generate conflict clause:
     //
-    if (proof != NULL) proof->beginChain(confl->id());
+    if (proof != NULL) proof->beginChain(ca[confl].id());
     out_learnt.push();          // (leave room for the asserting literal)
     out_btlevel = 0;
     int index = trail.size()-1;
     for(;;){
-        assert(confl != NULL);  // (otherwise should be UIP)
+        assert(confl != CRef_Undef);    // (otherwise should be UIP)
 
-        Clause& c = *confl;
-        if (c.learnt())
-            claBumpActivity(&c);
+        Clause& c = ca[confl];
+        if (c.learnt()){
+            claBumpActivity(c);
+            if (c.lbd() > core_lbd){
+                int n = computeLbd(c);
+                if (n < c.lbd()) c.setLbd(n); }
+            c.setUsed(true); }
 
         for (int j = (p == lit_Undef) ? 0 : 1; j < c.size(); j++){
             Lit q = c[j];
@@ -288,7 +340,7 @@ void Solver::analyze(Clause* confl, vec<Lit>& out_learnt, int& out_btlevel)
         pathC--;
         if (pathC == 0) break;
 
-        if (proof != NULL) proof->resolve(confl->id(), ~p);
+        if (proof != NULL) proof->resolve(ca[confl].id(), ~p);
     }
     out_learnt[0] = ~p;
 
@@ -304,18 +356,18 @@ void Solver::analyze(Clause* confl, vec<Lit>& out_learnt, int& out_btlevel)
 
         analyze_toclear.clear();
         for (i = j = 1; i < out_learnt.size(); i++)
-            if (reason[var(out_learnt[i])] == NULL || !analyze_removable(out_learnt[i], min_level))
+            if (reason[var(out_learnt[i])] == CRef_Undef || !analyze_removable(out_learnt[i], min_level))
                 out_learnt[j++] = out_learnt[i];
     }else if(expensive_ccmin == 1){
         // Simplify conflict clause (a little):
         //
         analyze_toclear.clear();
         for (i = j = 1; i < out_learnt.size(); i++){
-            Clause* r = reason[var(out_learnt[i])];
-            if (r == NULL)
+            CRef r = reason[var(out_learnt[i])];
+            if (r == CRef_Undef)
                 out_learnt[j++] = out_learnt[i];
             else{
-                Clause& c = *r;
+                Clause& c = ca[r];
                 for (int k = 1; k < c.size(); k++)
                     if (!seen[var(c[k])] && level[var(c[k])] != 0){
                         out_learnt[j++] = out_learnt[i];
@@ -334,7 +386,7 @@ void Solver::analyze(Clause* confl, vec<Lit>& out_learnt, int& out_btlevel)
         for (int k = 0; k < analyze_toclear.size(); k++){
             Var     v = var(analyze_toclear[k]); assert(level[v] > 0);
 				Lit     l = analyze_toclear[k];
-            Clause& c = *reason[v];
+            Clause& c = ca[reason[v]];
             proof->resolve(c.id(), l);
             for (int k = 1; k < c.size(); k++)
                 if (level[var(c[k])] == 0)
@@ -350,6 +402,7 @@ void Solver::analyze(Clause* confl, vec<Lit>& out_learnt, int& out_btlevel)
     stats.max_literals += out_learnt.size();
     out_learnt.shrink(i - j);
     stats.tot_literals += out_learnt.size();
+    out_lbd = computeLbd(out_learnt);
 }
 
 
@@ -357,17 +410,17 @@ void Solver::analyze(Clause* confl, vec<Lit>& out_learnt, int& out_btlevel)
 //
 bool Solver::analyze_removable(Lit p, uint min_level)
 {
-    assert(reason[var(p)] != NULL);
+    assert(reason[var(p)] != CRef_Undef);
     analyze_stack.clear(); analyze_stack.push(p);
     int top = analyze_toclear.size();
     while (analyze_stack.size() > 0){
-        assert(reason[var(analyze_stack.last())] != NULL);
-        Clause& c = *reason[var(analyze_stack.last())];
+        assert(reason[var(analyze_stack.last())] != CRef_Undef);
+        Clause& c = ca[reason[var(analyze_stack.last())]];
         analyze_stack.pop();
         for (int i = 1; i < c.size(); i++){
             Lit p = c[i];
             if (!analyze_seen[var(p)] && level[var(p)] != 0){
-                if (reason[var(p)] != NULL && ((1 << (level[var(p)] & 31)) & min_level) != 0){
+                if (reason[var(p)] != CRef_Undef && ((1 << (level[var(p)] & 31)) & min_level) != 0){
                     analyze_seen[var(p)] = 1;
                     analyze_stack.push(p);
                     analyze_toclear.push(p);
@@ -388,7 +441,7 @@ bool Solver::analyze_removable(Lit p, uint min_level)
 
 /*_________________________________________________________________________________________________
 |
-|  analyzeFinal : (confl : Clause*) (skip_first : bool)  ->  [void]
+|  analyzeFinal : (confl : CRef) (skip_first : bool)  ->  [void]
 |  
 |  Description:
 |    Specialized analysis procedure to express the final conflict in terms of assumptions.
@@ -396,7 +449,7 @@ bool Solver::analyze_removable(Lit p, uint min_level)
 |    making assumptions). If 'skip_first' is TRUE, the first literal of 'confl' is  ignored (needed
 |    if conflict arose before search even started).
 |________________________________________________________________________________________________@*/
-void Solver::analyzeFinal(Clause* confl, bool skip_first)
+void Solver::analyzeFinal(CRef cr, bool skip_first)
 {
     // -- NOTE! This code is relatively untested. Please report bugs!
     conflict.clear();
@@ -405,10 +458,11 @@ void Solver::analyzeFinal(Clause* confl, bool skip_first)
         return; }
    //assert(false);
     vec<char>&     seen  = analyze_seen;
-    if (proof != NULL) proof->beginChain(confl->id());
-    for (int i = skip_first ? 1 : 0; i < confl->size(); i++){
-        Var     x = var((*confl)[i]);
-		  Lit		 l = (*confl)[i];
+    const Clause&  confl = ca[cr];
+    if (proof != NULL) proof->beginChain(confl.id());
+    for (int i = skip_first ? 1 : 0; i < confl.size(); i++){
+        Var     x = var(confl[i]);
+		  Lit		 l = confl[i];
         if (level[x] > 0)
             seen[x] = 1;
         else
@@ -420,12 +474,12 @@ void Solver::analyzeFinal(Clause* confl, bool skip_first)
         Var     x = var(trail[i]);
 		  Lit     l = trail[i];
         if (seen[x]){
-            Clause* r = reason[x];
-            if (r == NULL){
+            CRef r = reason[x];
+            if (r == CRef_Undef){
                 assert(level[x] > 0);
                 conflict.push(~trail[i]);
             }else{
-                Clause& c = *r;
+                Clause& c = ca[r];
                 if (proof != NULL) proof->resolve(c.id(), l);
                 for (int j = 1; j < c.size(); j++)
                     if (level[var(c[j])] > 0)
@@ -442,7 +496,7 @@ void Solver::analyzeFinal(Clause* confl, bool skip_first)
 
 /*_________________________________________________________________________________________________
 |
-|  enqueue : (p : Lit) (from : Clause*)  ->  [bool]
+|  enqueue : (p : Lit) (from : CRef)  ->  [bool]
 |  
 |  Description:
 |    Puts a new fact on the propagation queue as well as immediately updating the variable's value.
@@ -451,12 +505,12 @@ void Solver::analyzeFinal(Clause* confl, bool skip_first)
 |  Input:
 |    p    - The fact to enqueue
 |    from - [Optional] Fact propagated from this (currently) unit clause. Stored in 'reason[]'.
-|           Default value is NULL (no reason).
+|           Default value is CRef_Undef (no reason).
 |  
 |  Output:
 |    TRUE if fact was enqueued without conflict, FALSE otherwise.
 |________________________________________________________________________________________________@*/
-bool Solver::enqueue(Lit p, Clause* from)
+bool Solver::enqueue(Lit p, CRef from)
 {
     if (value(p) != l_Undef)
         return value(p) != l_False;
@@ -473,73 +527,115 @@ bool Solver::enqueue(Lit p, Clause* from)
 
 
 
+// Proof logging for 'c' having become unit at decision level 0 ('c[0]' is the implied literal). If
+// 'c[0]' is already false, the empty clause is derived.
+//
+void Solver::logUnit(const Clause& c)
+{
+    Lit first = c[0];
+    proof->beginChain(c.id());
+    for (int k = 1; k < c.size(); k++)
+        proof->resolve(unit_id[var(c[k])], c[k]);
+    ClauseId id = proof->endChain();
+    assert(unit_id[var(first)] == ClauseId_NULL || value(first) == l_False);    // (if variable already has 'id', it must be with the other polarity and we should have derived the empty clause here)
+    if (value(first) != l_False)
+        unit_id[var(first)] = id;
+    else{
+        // Empty clause derived:
+        proof->beginChain(unit_id[var(first)]);
+        proof->resolve(id, ~first);
+        proof->endChain();
+    }
+}
+
+
 /*_________________________________________________________________________________________________
 |
-|  propagate : [void]  ->  [Clause*]
+|  propagate : [void]  ->  [CRef]
 |  
 |  Description:
 |    Propagates all enqueued facts. If a conflict arises, the conflicting clause is returned,
-|    otherwise NULL. NOTE! This method has been optimized for speed rather than readability.
+|    otherwise CRef_Undef. NOTE! This method has been optimized for speed rather than readability.
+|    Binary clauses are propagated first from 'bin_watches', which hold the implied literal, so
+|    they are only dereferenced to become a reason or the conflict. A longer clause is skipped
+|    without being read when the blocker of its watcher is true.
 |  
 |    Post-conditions:
 |      * The propagation queue is empty, even if there was a conflict.
 |________________________________________________________________________________________________@*/
-Clause* Solver::propagate()
+CRef Solver::propagate()
 {
-    Clause* confl = NULL;
+    CRef    confl = CRef_Undef;
     while (qhead < trail.size()){
         stats.propagations++;
         simpDB_props--;
 
         Lit            p  = trail[qhead++];     // 'p' is enqueued fact to propagate.
-        vec<Clause*>&  ws = watches[index(p)];
-        Clause**       i,** j,** end;
+        Lit            false_lit = ~p;
+
+        vec<Watcher>&  bs = bin_watches[index(p)];
+        for (int k = 0; k < bs.size(); k++){
+            Lit   imp = bs[k].blocker;
+            lbool val = value(imp);
+            if (val == l_True) continue;
+
+            CRef    cr = bs[k].cref;
+            Clause& c  = ca[cr];
+            if (c[0] != imp)                    // (a reason has its implied literal in data[0])
+                c[1] = c[0], c[0] = imp;
+            assert(c[1] == false_lit);
+            if (decisionLevel() == 0 && proof != NULL)
+                logUnit(c);
+            if (val == l_False){
+                if (decisionLevel() == 0)
+                    ok = false;
+                confl = cr;
+                qhead = trail.size();
+                return confl;
+            }
+            enqueue(imp, cr);
+        }
+
+        vec<Watcher>&  ws = watches[index(p)];
+        Watcher        *i, *j, *end;
 
-        for (i = j = (Clause**)ws, end = i + ws.size();  i != end;){
-            Clause& c = **i; i++;
+        for (i = j = (Watcher*)ws, end = i + ws.size();  i != end;){
+            // Skip the clause if the blocker is true:
+            if (value(i->blocker) == l_True){
+                *j++ = *i++; continue; }
+
+            CRef    cr = i->cref;
+            Clause& c  = ca[cr]; i++;
             // Make sure the false literal is data[1]:
-            Lit false_lit = ~p;
             if (c[0] == false_lit)
                 c[0] = c[1], c[1] = false_lit;
 
             assert(c[1] == false_lit);
 
             // If 0th watch is true, then clause is already satisfied.
-            Lit   first = c[0];
-            lbool val   = value(first);
+            Lit     first = c[0];
+            Watcher w(cr, first);
+            lbool   val   = value(first);
             if (val == l_True){
-                *j++ = &c;
+                *j++ = w;
             }else{
                 // Look for new watch:
                 for (int k = 2; k < c.size(); k++)
                     if (value(c[k]) != l_False){
                         c[1] = c[k]; c[k] = false_lit;
-                        watches[index(~c[1])].push(&c);
+                        watches[index(~c[1])].push(w);
                         goto FoundWatch; }
 
                 // Did not find watch -- clause is unit under assignment:
-                if (decisionLevel() == 0 && proof != NULL){
+                if (decisionLevel() == 0 && proof != NULL)
                     // Log the production of this unit clause:
-                    proof->beginChain(c.id());
-                    for (int k = 1; k < c.size(); k++)
-                        proof->resolve(unit_id[var(c[k])], c[k]);
-                    ClauseId id = proof->endChain();
-                    assert(unit_id[var(first)] == ClauseId_NULL || value(first) == l_False);    // (if variable already has 'id', it must be with the other polarity and we should have derived the empty clause here)
-                    if (value(first) != l_False)
-                        unit_id[var(first)] = id;
-                    else{
-                        // Empty clause derived:
-                        proof->beginChain(unit_id[var(first)]);
-                        proof->resolve(id, ~first);
-                        proof->endChain();
-                    }
-                }
-					 
-                *j++ = &c;
-                if (!enqueue(first, &c)){
+                    logUnit(c);
+
+                *j++ = w;
+                if (!enqueue(first, cr)){
                     if (decisionLevel() == 0)
                         ok = false;
-                    confl = &c;
+                    confl = cr;
                     qhead = trail.size();
                     // Copy the remaining watches:
                     while (i < end)
@@ -560,29 +656,72 @@ Clause* Solver::propagate()
 |  reduceDB : ()  ->  [void]
 |  
 |  Description:
-|    Remove half of the learnt clauses, minus the clauses locked by the current assignment. Locked
-|    clauses are clauses that are reason to some assignment. Binary clauses are never removed.
+|    Remove the less useful half of the learnt clauses that are not protected. A learnt clause is
+|    ranked by its LBD (literal block distance: the number of decision levels among its literals
+|    when it was learnt or last used), then by its activity. Protected are:
+|      * binary clauses and "core" clauses (LBD <= 'core_lbd'), for good;
+|      * "tier 2" clauses (LBD <= 'tier2_lbd') that were used by 'analyze()' since the last call;
+|      * locked clauses, i.e. clauses that are reason to some assignment.
 |________________________________________________________________________________________________@*/
-struct reduceDB_lt { bool operator () (Clause* x, Clause* y) { return x->size() > 2 && (y->size() == 2 || x->activity() < y->activity()); } };
+struct reduceDB_lt {
+    const ClauseAllocator& ca;
+    reduceDB_lt(const ClauseAllocator& ca_) : ca(ca_) {}
+    bool operator () (CRef x, CRef y) {     // (worst first)
+        return ca[x].lbd() > ca[y].lbd() || (ca[x].lbd() == ca[y].lbd() && ca[x].activity() < ca[y].activity()); } };
 void Solver::reduceDB()
 {
-    int     i, j;
-    double  extra_lim = cla_inc / learnts.size();    // Remove any clause below this activity
+    vec<CRef>&  local = reduce_local;
+    int         i, j;
 
-    sort(learnts, reduceDB_lt());
-    for (i = j = 0; i < learnts.size() / 2; i++){
-        if (learnts[i]->size() > 2 && !locked(learnts[i]))
-            remove(learnts[i]);
-        else
+    local.clear();
+    for (i = j = 0; i < learnts.size(); i++){
+        Clause& c = ca[learnts[i]];
+        if (c.size() == 2 || c.lbd() <= core_lbd || (c.lbd() <= tier2_lbd && c.used()) || locked(learnts[i]))
             learnts[j++] = learnts[i];
-    }
-    for (; i < learnts.size(); i++){
-        if (learnts[i]->size() > 2 && !locked(learnts[i]) && learnts[i]->activity() < extra_lim)
-            remove(learnts[i]);
         else
-            learnts[j++] = learnts[i];
+            local.push(learnts[i]);
+        c.setUsed(false);
     }
     learnts.shrink(i - j);
+    nof_protected = j;
+
+    sort(local, reduceDB_lt(ca));
+    for (i = 0; i < local.size() / 2; i++)
+        remove(local[i]);
+    for (; i < local.size(); i++)
+        learnts.push(local[i]);
+    checkGarbage();
+}
+
+
+/*_________________________________________________________________________________________________
+|
+|  garbageCollect : [void]  ->  [void]
+|  
+|  Description:
+|    Move all the live clauses to a new region of exactly the wasted-free size, in the order of
+|    the watch lists (so the clauses looked at together by 'propagate()' end up close together),
+|    and update every reference: watchers, reasons and the clause lists.
+|________________________________________________________________________________________________@*/
+void Solver::garbageCollect()
+{
+    ClauseAllocator to;
+    for (int type = 0; type < 2; type++){
+        vec<vec<Watcher> >& wss = type ? watches : bin_watches;
+        for (int i = 0; i < wss.size(); i++){
+            vec<Watcher>& ws = wss[i];
+            for (int k = 0; k < ws.size(); k++)
+                ca.reloc(ws[k].cref, to);
+        }
+    }
+    for (int i = 0; i < trail.size(); i++){
+        Var x = var(trail[i]);
+        if (reason[x] != CRef_Undef)
+            ca.reloc(reason[x], to);
+    }
+    for (int i = 0; i < learnts.size(); i++) ca.reloc(learnts[i], to);
+    for (int i = 0; i < clauses.size(); i++) ca.reloc(clauses[i], to);
+    to.moveTo(ca);
 }
 
 
@@ -599,7 +738,7 @@ void Solver::simplifyDB()
     if (!ok) return;    // GUARD (public method)
     assert(decisionLevel() == 0);
 
-    if (propagate() != NULL){
+    if (propagate() != CRef_Undef){
         ok = false;
         return; }
 
@@ -611,20 +750,23 @@ void Solver::simplifyDB()
         Lit p = trail[i];
         watches[index( p)].clear(true);
         watches[index(~p)].clear(true);
+        bin_watches[index( p)].clear(true);
+        bin_watches[index(~p)].clear(true);
     }
 
     // Remove satisfied clauses:
     for (int type = 0; type < 2; type++){
-        vec<Clause*>& cs = type ? learnts : clauses;
+        vec<CRef>&    cs = type ? learnts : clauses;
         int           j  = 0;
         for (int i = 0; i < cs.size(); i++){
-            if (!locked(cs[i]) && simplify(cs[i]))
+            if (!locked(cs[i]) && simplify(ca[cs[i]]))
                 remove(cs[i]);
             else
                 cs[j++] = cs[i];
         }
         cs.shrink(cs.size()-j);
     }
+    checkGarbage();
 
     simpDB_assigns = nAssigns();
     simpDB_props   = stats.clauses_literals + stats.learnts_literals;   // (shouldn't depend on 'stats' really, but it will do for now)
@@ -636,9 +778,10 @@ void Solver::simplifyDB()
 |  search : (nof_conflicts : int) (nof_learnts : int) (params : const SearchParams&)  ->  [lbool]
 |  
 |  Description:
-|    Search for a model the specified number of conflicts, keeping the number of learnt clauses
-|    below the provided limit. NOTE! Use negative value for 'nof_conflicts' or 'nof_learnts' to
-|    indicate infinity.
+|    Search for a model the specified number of conflicts (or, with 'restart_glucose', until
+|    'glucoseRestart()' holds), keeping the number of unprotected learnt clauses below the
+|    provided limit. NOTE! Use negative value for 'nof_conflicts' or 'nof_learnts' to indicate
+|    infinity.
 |  
 |  Output:
 |    'l_True' if a partial assigment that is consistent with respect to the clauseset is found. If
@@ -657,20 +800,31 @@ lbool Solver::search(int nof_conflicts, int nof_learnts, const SearchParams& par
     model.clear();
 
     for (;;){
-        Clause* confl = propagate();
-        if (confl != NULL){
+        CRef confl = propagate();
+        if (confl != CRef_Undef){
             // CONFLICT
 
             stats.conflicts++; conflictC++;
             vec<Lit>    learnt_clause;
-            int         backtrack_level;
+            int         backtrack_level, lbd;
             if (decisionLevel() == root_level){
                 // Contradiction found:
                 analyzeFinal(confl);
                 return l_False; }
-            analyze(confl, learnt_clause, backtrack_level);
+            analyze(confl, learnt_clause, backtrack_level, lbd);
             cancelUntil(max(backtrack_level, root_level));
             newClause(learnt_clause, true, (proof != NULL) ? proof->last() : ClauseId_NULL);
+            if (learnt_clause.size() > 1) ca[learnts.last()].setLbd(lbd);
+
+            // Statistics for 'glucoseRestart()':
+            lbd_total += lbd; lbd_count++;
+            if (lbd_queue.size() < restart_window)
+                lbd_queue.push(lbd), lbd_qsum += lbd;
+            else{
+                lbd_qsum += lbd - lbd_queue[lbd_qhead];
+                lbd_queue[lbd_qhead] = lbd;
+                lbd_qhead = (lbd_qhead + 1) % restart_window; }
+
             if (learnt_clause.size() == 1) level[var(learnt_clause[0])] = 0;    // (this is ugly (but needed for 'analyzeFinal()') -- in future versions, we will backtrack past the 'root_level' and redo the assumptions)
             varDecayActivity();
             claDecayActivity();
@@ -678,9 +832,10 @@ lbool Solver::search(int nof_conflicts, int nof_learnts, const SearchParams& par
         }else{
             // NO CONFLICT
 
-            if (nof_conflicts >= 0 && conflictC >= nof_conflicts){
-                // Reached bound on number of conflicts:
+            if ((nof_conflicts >= 0 && conflictC >= nof_conflicts) || glucoseRestart() || !withinBudget()){
+                // Reached bound on number of conflicts (or the budget of 'solve()'):
                 progress_estimate = progressEstimate();
+                lbd_queue.clear(), lbd_qhead = 0, lbd_qsum = 0;
                 cancelUntil(root_level);
                 return l_Undef; }
 
@@ -688,15 +843,15 @@ lbool Solver::search(int nof_conflicts, int nof_learnts, const SearchParams& par
                 // Simplify the set of problem clauses:
                 simplifyDB(), assert(ok);
 
-            if (nof_learnts >= 0 && learnts.size()-nAssigns() >= nof_learnts)
+            if (nof_learnts >= 0 && learnts.size()-nof_protected-nAssigns() >= nof_learnts)
                 // Reduce the set of learnt clauses:
                 reduceDB();
 
             // New variable decision:
             stats.decisions++;
-            Var next = order.select(params.random_var_freq);
+            Lit next = pickBranchLit(params);
 
-            if (next == var_Undef){
+            if (next == lit_Undef){
                 // Model found:
                 model.growTo(nVars());
                 for (int i = 0; i < nVars(); i++) model[i] = value(i);
@@ -704,12 +859,34 @@ lbool Solver::search(int nof_conflicts, int nof_learnts, const SearchParams& par
                 return l_True;
             }
 
-            check(assume(~Lit(next)));
+            check(assume(next));
         }
     }
 }
 
 
+// Pick a decision variable from the activity order and give it the phase it had last (negative
+// for a variable that was never assigned). Returns 'lit_Undef' if all decision variables are
+// assigned.
+//
+Lit Solver::pickBranchLit(const SearchParams& params)
+{
+    Var next = order.select(params.random_var_freq);
+    return next == var_Undef ? lit_Undef : Lit(next, polarity[next]);
+}
+
+
+// Glucose restarts: restart when the average LBD of the last 'restart_window' learnt clauses,
+// scaled by 'restart_k', is above the average of all of them -- i.e. when the solver currently
+// learns worse clauses than usual.
+//
+bool Solver::glucoseRestart() const
+{
+    return restart_policy == restart_glucose && lbd_queue.size() == restart_window
+        && lbd_qsum * restart_k * lbd_count > (double)lbd_total * restart_window;
+}
+
+
 // Return search-space coverage. Not extremely reliable.
 //
 double Solver::progressEstimate()
@@ -738,7 +915,7 @@ void Solver::varRescaleActivity()
 void Solver::claRescaleActivity()
 {
     for (int i = 0; i < learnts.size(); i++)
-        learnts[i]->activity() *= 1e-20;
+        ca[learnts[i]].activity() *= 1e-20;
     cla_inc *= 1e-20;
 }
 
@@ -756,13 +933,14 @@ void Solver::claRescaleActivity()
 |    A list of assumptions (unit clauses coded as literals). Pre-condition: The assumptions must
 |    not contain both 'x' and '~x' for any variable 'x'.
 |________________________________________________________________________________________________@*/
-bool Solver::solve(const vec<Lit>& assumps)
+lbool Solver::solveLimited(const vec<Lit>& assumps)
 {
     simplifyDB();
-    if (!ok) return false;
+    if (!ok) return l_False;
 
     SearchParams    params(default_params);
-    double  nof_conflicts = 100;
+    double  nof_conflicts = restart_first;
+    int     curr_restarts = 0;
     double  nof_learnts   = nClauses() / 3;
     lbool   status        = l_Undef;
 
@@ -772,7 +950,7 @@ bool Solver::solve(const vec<Lit>& assumps)
         Lit p = assumps[i];
         assert(var(p) < nVars());
         if (!assume(p)){
-            if (reason[var(p)] != NULL){
+            if (reason[var(p)] != CRef_Undef){
                 analyzeFinal(reason[var(p)], true);
                 conflict.push(~p);
             }else{
@@ -782,12 +960,12 @@ bool Solver::solve(const vec<Lit>& assumps)
                 if (proof != NULL) conflict_id = unit_id[var(p)];
             }
             cancelUntil(0);
-            return false; }
-        Clause* confl = propagate();
-        if (confl != NULL){
+            return l_False; }
+        CRef confl = propagate();
+        if (confl != CRef_Undef){
             analyzeFinal(confl), assert(conflict.size() > 0);
             cancelUntil(0);
-            return false; }
+            return l_False; }
     }
     assert(root_level == decisionLevel());
 
@@ -815,14 +993,14 @@ bool Solver::solve(const vec<Lit>& assumps)
                    progress_estimate*100);
             fflush(stdout);
         }
-        status = search((int)nof_conflicts, (int)nof_learnts, params);
+        int limit = restart_policy == restart_luby      ? (int)(luby(2, curr_restarts) * restart_first)
+                  : restart_policy == restart_geometric ? (int)nof_conflicts
+                  :                                       -1;
+        status = search(limit, (int)nof_learnts, params);
         nof_conflicts *= 1.5;
         nof_learnts   *= 1.1;
-
-if ((int)stats.conflicts >= effLimit) {
-   cancelUntil(0);
-   return status == l_True;
-}
+        curr_restarts++;
+        if (status == l_Undef && !withinBudget()) break;
     }
     if (verbosity >= 1) {
         reportf("===========================================");
@@ -830,7 +1008,57 @@ if ((int)stats.conflicts >= effLimit) {
     }
 
     cancelUntil(0);
-    return status == l_True;
+    return status;
+}
+
+
+/*_________________________________________________________________________________________________
+|
+|  lexMin : (assumps : const vec<Lit>&) (lits : vec<Lit>&)  ->  [void]
+|  
+|  Description:
+|    Make 'lits' the least model on their variables under 'assumps' (false before true, 'lits[0]'
+|    first): each variable in turn is made false if some model with the ones before it as they
+|    are still has it so. The assumptions and the variables done stay on the trail, so a variable
+|    costs a 'search()' only if it is true in 'lits' and not implied by the ones before it. The
+|    budget is switched off.
+|  
+|  Input:
+|    'lits' must be true in some model under 'assumps' (e.g. the last one of 'solve()').
+|________________________________________________________________________________________________@*/
+void Solver::lexMin(const vec<Lit>& assumps, vec<Lit>& lits)
+{
+    assert(decisionLevel() == 0);
+    budgetOff();
+    SearchParams    params(default_params);
+    double  nof_learnts = nClauses() / 3;
+    bool    fine        = true;     // (a model extends the trail, so nothing can conflict)
+
+    for (int i = 0; i < assumps.size() && fine; i++)
+        fine = assume(assumps[i]) && propagate() == CRef_Undef;
+    for (int i = 0; i < lits.size() && fine; i++){
+        Var x = var(lits[i]);
+        if (value(x) != l_Undef)
+            lits[i] = Lit(x, value(x) == l_False);
+        else if (sign(lits[i]))
+            fine = assume(lits[i]) && propagate() == CRef_Undef;
+        else{
+            check(assume(~lits[i]));
+            root_level = decisionLevel();
+            lbool status;
+            while ((status = search(-1, (int)nof_learnts, params)) == l_Undef)
+                nof_learnts *= 1.1;
+            if (status == l_True)
+                for (int j = i; j < lits.size(); j++)
+                    lits[j] = Lit(var(lits[j]), model[var(lits[j])] == l_False);
+            else{
+                cancelUntil(decisionLevel() - 1);
+                fine = assume(lits[i]) && propagate() == CRef_Undef; }
+        }
+    }
+    assert(fine);
+    cancelUntil(0);
+    root_level = 0;
 }
 
 void Solver::printStats()
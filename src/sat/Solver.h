@@ -40,6 +40,14 @@ struct SolverStats {
 };
 
 
+// Restart policies ('Solver::restart_policy'):
+enum RestartPolicy {
+    restart_luby,       // after 'restart_first' times the Luby sequence 1 1 2 1 1 2 4 ... conflicts
+    restart_glucose,    // when the LBD of the recent learnt clauses is above average (see 'search()')
+    restart_geometric   // after 'restart_first' * 1.5^k conflicts (the MiniSat 1.14 schedule)
+};
+
+
 struct SearchParams {
     double  var_decay, clause_decay, random_var_freq;    // (reasonable values are: 0.95, 0.999, 0.02)    
     SearchParams(double v = 1, double c = 1, double r = 0) : var_decay(v), clause_decay(c), random_var_freq(r) { }
@@ -51,8 +59,9 @@ protected:
     // Solver state:
     //
     bool                ok;               // If FALSE, the constraints are already unsatisfiable. No part of the solver state may be used!
-    vec<Clause*>        clauses;          // List of problem clauses.
-    vec<Clause*>        learnts;          // List of learnt clauses.
+    ClauseAllocator     ca;               // Memory of all the clauses.
+    vec<CRef>           clauses;          // List of problem clauses.
+    vec<CRef>           learnts;          // List of learnt clauses.
     vec<ClauseId>       unit_id;          // 'unit_id[var]' is the clause ID for the unit literal 'var' or '~var' (if set at toplevel).
     double              cla_inc;          // Amount to bump next clause with.
     double              cla_decay;        // INVERSE decay factor for clause activity: stores 1/decay.
@@ -62,25 +71,35 @@ protected:
     double              var_decay;        // INVERSE decay factor for variable activity: stores 1/decay. Use negative value for static variable order.
     VarOrder            order;            // Keeps track of the decision variable order.
 
-    vec<vec<Clause*> >  watches;          // 'watches[lit]' is a list of constraints watching 'lit' (will go there if literal becomes true).
+    vec<vec<Watcher> >  watches;          // 'watches[lit]' is a list of constraints watching 'lit' (will go there if literal becomes true).
+    vec<vec<Watcher> >  bin_watches;      // The same for binary clauses; the blocker is the literal they imply.
     vec<char>           assigns;          // The current assignments (lbool:s stored as char:s).
     vec<Lit>            trail;            // Assignment stack; stores all assigments made in the order they were made.
     vec<int>            trail_lim;        // Separator indices for different decision levels in 'trail[]'.
-    vec<Clause*>        reason;           // 'reason[var]' is the clause that implied the variables current value, or 'NULL' if none.
+    vec<CRef>           reason;           // 'reason[var]' is the clause that implied the variables current value, or 'CRef_Undef' if none.
     vec<int>            level;            // 'level[var]' is the decision level at which assignment was made.
     vec<int>            trail_pos;        // 'trail_pos[var]' is the variable's position in 'trail[]'. This supersedes 'level[]' in some sense, and 'level[]' will probably be removed in future releases.
     int                 root_level;       // Level of first proper decision.
     int                 qhead;            // Head of queue (as index into the trail -- no more explicit propagation queue in MiniSat).
     int                 simpDB_assigns;   // Number of top-level assignments since last execution of 'simplifyDB()'.
     int64               simpDB_props;     // Remaining number of propagations that must be made before next execution of 'simplifyDB()'.
+    vec<char>           polarity;         // 'polarity[var]' is the sign the variable had when it was last unassigned (phase saving).
+    vec<char>           decision;         // 'decision[var]' is TRUE if the variable may be picked by 'pickBranchLit()'.
+    int                 nof_protected;    // Learnt clauses kept by their tier in the last 'reduceDB()' (not counted against 'nof_learnts').
+    vec<int>            lbd_queue;        // LBDs of the last 'restart_window' learnt clauses (a ring buffer) ...
+    int                 lbd_qhead;
+    int64               lbd_qsum;         // ... and their sum.
+    int64               lbd_total;        // Sum and number of the LBDs of all the learnt clauses so far.
+    int64               lbd_count;
 
     // Temporaries (to reduce allocation overhead). Each variable is prefixed by the method in which is used:
     //
     vec<char>           analyze_seen;
     vec<Lit>            analyze_stack;
     vec<Lit>            analyze_toclear;
-    Clause*             propagate_tmpbin;
-    Clause*             analyze_tmpbin;
+    vec<uint>           lbd_seen;         // 'lbd_seen[level] == lbd_stamp' if 'level' is counted by 'computeLbd()'.
+    uint                lbd_stamp;
+    vec<CRef>           reduce_local;
     vec<Lit>            addUnit_tmp;
     vec<Lit>            addBinary_tmp;
     vec<Lit>            addTernary_tmp;
@@ -90,15 +109,21 @@ protected:
     bool        assume           (Lit p);
     void        cancelUntil      (int level);
     void        record           (const vec<Lit>& clause);
+    void        attach           (CRef cr);
 
-    void        analyze          (Clause* confl, vec<Lit>& out_learnt, int& out_btlevel); // (bt = backtrack)
+    void        analyze          (CRef confl, vec<Lit>& out_learnt, int& out_btlevel, int& out_lbd); // (bt = backtrack)
     bool        analyze_removable(Lit p, uint min_level);                                 // (helper method for 'analyze()')
-    void        analyzeFinal     (Clause* confl, bool skip_first = false);
-    bool        enqueue          (Lit fact, Clause* from = NULL);
-    Clause*     propagate        ();
+    void        analyzeFinal     (CRef confl, bool skip_first = false);
+    bool        enqueue          (Lit fact, CRef from = CRef_Undef);
+    void        logUnit          (const Clause& c);
+    CRef        propagate        ();
     void        reduceDB         ();
+    void        garbageCollect   ();
     Lit         pickBranchLit    (const SearchParams& params);
     lbool       search           (int nof_conflicts, int nof_learnts, const SearchParams& params);
+    bool        glucoseRestart   () const;
+    template<class C>
+    int         computeLbd       (const C& c);
     double      progressEstimate ();
 
     // Activity:
@@ -115,10 +140,11 @@ protected:
     // Operations on clauses:
     //
     void     newClause(const vec<Lit>& ps, bool learnt = false, ClauseId id = ClauseId_NULL, bool A = true);
-    void     claBumpActivity (Clause* c) { if ( (c->activity() += cla_inc) > 1e20 ) claRescaleActivity(); }
-    void     remove          (Clause* c, bool just_dealloc = false);
-    bool     locked          (const Clause* c) const { return reason[var((*c)[0])] == c; }
-    bool     simplify        (Clause* c) const;
+    void     claBumpActivity (Clause& c) { if ( (c.activity() += cla_inc) > 1e20 ) claRescaleActivity(); }
+    void     remove          (CRef cr);
+    bool     locked          (CRef cr) const { return reason[var(ca[cr][0])] == cr; }
+    bool     simplify        (const Clause& c) const;
+    void     checkGarbage    () { if (ca.wasted() > ca.size() * garbage_frac) garbageCollect(); }
 
     int      decisionLevel() const { return trail_lim.size(); }
 
@@ -128,31 +154,39 @@ public:
              , cla_decay        (1)
              , var_inc          (1)
              , var_decay        (1)
-             , order            (assigns, activity)
+             , order            (assigns, decision, activity)
              , qhead            (0)
              , simpDB_assigns   (0)
              , simpDB_props     (0)
+             , nof_protected    (0)
+             , lbd_qhead        (0)
+             , lbd_qsum         (0)
+             , lbd_total        (0)
+             , lbd_count        (0)
+             , lbd_stamp        (0)
              , default_params   (SearchParams(0.95, 0.999, 0.02))
              , expensive_ccmin  (2)
              , proof            (NULL)
              , verbosity        (0)
+             , garbage_frac     (0.20)
+             , restart_policy   (restart_glucose)
+             , restart_first    (100)
+             , restart_window   (50)
+             , restart_k        (0.6)
+             , core_lbd         (2)
+             , tier2_lbd        (6)
              , progress_estimate(0)
              , conflict_id      (ClauseId_NULL)
+             , conflict_budget  (-1)
+             , propagation_budget(-1)
              {
-                vec<Lit> dummy(2,lit_Undef);
-                propagate_tmpbin = Clause_new(false, dummy);
-                analyze_tmpbin   = Clause_new(false, dummy);
+                lbd_seen      .push(0);     // (for level 0; 'newVar()' adds one per level)
                 addUnit_tmp   .growTo(1);
                 addBinary_tmp .growTo(2);
                 addTernary_tmp.growTo(3);
              }
 
-   ~Solver() {
-       for (int i = 0; i < learnts.size(); i++) remove(learnts[i], true);
-       for (int i = 0; i < clauses.size(); i++) if (clauses[i] != NULL) remove(clauses[i], true);
-       remove(propagate_tmpbin, true);
-       remove(analyze_tmpbin, true);
-    }
+   ~Solver() { }   // (the clauses go with 'ca')
 
     // Helpers: (semi-internal)
     //
@@ -175,11 +209,19 @@ public:
     int             expensive_ccmin;    // Controls conflict clause minimization. TRUE by default.
     Proof*          proof;              // Set this directly after constructing 'Solver' to enable proof logging. Initialized to NULL.
     int             verbosity;          // Verbosity level. 0=silent, 1=some progress report, 2=everything
+    double          garbage_frac;       // Compact the clause memory when this fraction of it is wasted.
+    int             restart_policy;     // A 'RestartPolicy'.
+    int             restart_first;      // Conflicts before the first restart (Luby and geometric).
+    int             restart_window;     // Glucose: compare the LBD average of this many recent learnt clauses ...
+    double          restart_k;          // ... times this factor with the overall average.
+    int             core_lbd;           // Learnt clauses with an LBD up to this are never removed,
+    int             tier2_lbd;          //   up to this are kept while they take part in conflicts.
 
     // Problem specification:
     //
     Var     newVar    ();
     int     nVars     ()                    { return assigns.size(); }
+    void    setDecisionVar(Var v, bool b)   { decision[v] = b; if (b) order.undo(v); }
     void    addUnit   (Lit p)               { addUnit_tmp   [0] = p; addClause(addUnit_tmp); }
     void    addBinary (Lit p, Lit q)        { addBinary_tmp [0] = p; addBinary_tmp [1] = q; addClause(addBinary_tmp); }
     void    addTernary(Lit p, Lit q, Lit r) { addTernary_tmp[0] = p; addTernary_tmp[1] = q; addTernary_tmp[2] = r; addClause(addTernary_tmp); }
@@ -190,13 +232,26 @@ public:
     //
     bool    okay() { return ok; }       // FALSE means solver is in an conflicting state (must never be used again!)
     void    simplifyDB();
-    bool    solve(const vec<Lit>& assumps);
+    bool    solve(const vec<Lit>& assumps) { return solveLimited(assumps) == l_True; }
     bool    solve() { vec<Lit> tmp; return solve(tmp); }
+    lbool   solveLimited(const vec<Lit>& assumps);   // l_Undef if the budget ran out
+    void    lexMin(const vec<Lit>& assumps, vec<Lit>& lits);   // least model on 'lits'
+
+    // Resource limits for the next calls of 'solve()', counted from now. Negative means no limit.
+    //
+    void    setConfBudget(int64 x) { conflict_budget    = x < 0 ? -1 : stats.conflicts    + x; }
+    void    setPropBudget(int64 x) { propagation_budget = x < 0 ? -1 : stats.propagations + x; }
+    void    budgetOff()            { conflict_budget = propagation_budget = -1; }
+    bool    withinBudget() const {
+        return (conflict_budget    < 0 || stats.conflicts    < conflict_budget)
+            && (propagation_budget < 0 || stats.propagations < propagation_budget); }
 
     double      progress_estimate;  // Set by 'search()'.
     vec<lbool>  model;              // If problem is satisfiable, this vector contains the model (if any).
     vec<Lit>    conflict;           // If problem is unsatisfiable under assumptions, this vector represent the conflict clause expressed in the assumptions.
     ClauseId    conflict_id;        // (In proof logging mode only.) ID for the clause 'conflict' (for proof traverseral). NOTE! The empty clause is always the last clause derived, but for conflicts under assumption, this is not necessarly true.
+    int64       conflict_budget;    // -1 means no budget.
+    int64       propagation_budget; // -1 means no budget.
 
     // Printing:
     //
@@ -81,36 +81,128 @@ const   int ClauseId_NULL = INT_MIN;
 
 //- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 
+// Clauses live in one 'ClauseAllocator' region and are referred to by their 32-bit offset in it.
+typedef uint CRef;
+const   CRef CRef_Undef = UINT_MAX;
+
 class Clause {
-    uint    size_learnt;
+    uint    header;     // size << 3 | hasId << 2 | reloced << 1 | learnt
     Lit     data[1];
 public:
     // NOTE: This constructor cannot be used directly (doesn't allocate enough memory).
     Clause(bool learnt, const vec<Lit>& ps, ClauseId id_ = ClauseId_NULL) {
-        size_learnt = (ps.size() << 1) | (int)learnt;
+        header = (ps.size() << 3) | ((int)(id_ != ClauseId_NULL) << 2) | (int)learnt;
         for (int i = 0; i < ps.size(); i++) data[i] = ps[i];
-        if (learnt) activity() = 0;
+        if (learnt) activity() = 0, data[size() + 1] = toLit(0);
         if (id_ != ClauseId_NULL) id() = id_; }
 
-    // -- use this function instead:
-    friend Clause* Clause_new(bool, const vec<Lit>&, ClauseId);
+    // -- use 'ClauseAllocator::alloc()' instead.
 
-    int       size        ()      const { return size_learnt >> 1; }
-    bool      learnt      ()      const { return size_learnt & 1; }
+    int       size        ()      const { return header >> 3; }
+    bool      learnt      ()      const { return header & 1; }
+    bool      hasId       ()      const { return header & 4; }
+    int       words       ()      const { return 1 + size() + 2 * (int)learnt() + (int)hasId(); }
     Lit       operator [] (int i) const { return data[i]; }
     Lit&      operator [] (int i)       { return data[i]; }
     float&    activity    ()      const {
         void *p = const_cast<Lit*>(&data[size()]); return *((float *)p);
     } //              return *((float*)&data[size()]); }
-    ClauseId& id          ()      const { return *((ClauseId*)&data[size() + (int)learnt()]); }
+    ClauseId& id          ()      const { return *((ClauseId*)&data[size() + 2 * (int)learnt()]); }
+
+    // Learnt clauses only: literal block distance (the number of decision levels of its literals
+    // when last computed) and whether it took part in a conflict since the last 'reduceDB()'.
+    int       lbd         ()      const { return index(data[size() + 1]) >> 1; }
+    bool      used        ()      const { return index(data[size() + 1]) & 1; }
+    void      setLbd      (int n)       { data[size() + 1] = toLit(n << 1 | (int)used()); }
+    void      setUsed     (bool u)      { data[size() + 1] = toLit(lbd() << 1 | (int)u); }
+
+    // Garbage collection: a moved clause keeps its new reference in place of its first literal.
+    bool      reloced     ()      const { return header & 2; }
+    CRef      relocation  ()      const { return (CRef)index(data[0]); }
+    void      relocate    (CRef c)      { header |= 2; data[0] = toLit((int)c); }
+};
+
+
+//=================================================================================================
+// ClauseAllocator -- one growable region for all the clauses of a solver:
+
+
+// A clause takes 'Clause::words()' words, without a 'malloc()' header of its own, and is
+// addressed by its offset. 'free()' only counts the words as wasted; they are given back by moving
+// the live clauses to a new region ('reloc()' for every reference to them, then 'moveTo()').
+class ClauseAllocator {
+    uint*   mem;
+    uint    sz;
+    uint    cap;
+    uint    wasted_;
+
+    void    capacity(uint min_cap) {
+        if (cap >= min_cap) return;
+        uint prev = cap;
+        while (cap < min_cap){
+            uint delta = ((cap >> 1) + (cap >> 3) + 2) & ~1;
+            cap += delta;
+            if (cap <= prev) { fprintf(stderr, "ClauseAllocator: out of memory\n"); abort(); } }
+        mem = xrealloc(mem, cap); }
+
+    // Don't allow copying:
+    ClauseAllocator(const ClauseAllocator&);
+    ClauseAllocator& operator = (const ClauseAllocator&);
+
+public:
+    ClauseAllocator() : mem(NULL), sz(0), cap(0), wasted_(0) { }
+   ~ClauseAllocator() { xfree(mem); }
+
+    uint    size  () const { return sz; }
+    uint    wasted() const { return wasted_; }
+
+    CRef    alloc(bool learnt, const vec<Lit>& ps, ClauseId id = ClauseId_NULL) {
+        assert(sizeof(Lit)      == sizeof(uint));
+        assert(sizeof(float)    == sizeof(uint));
+        assert(sizeof(ClauseId) == sizeof(uint));
+        uint n = 1 + ps.size() + 2 * (int)learnt + (int)(id != ClauseId_NULL);
+        capacity(sz + n);
+        CRef r = sz;
+        sz += n;
+        new (&mem[r]) Clause(learnt, ps, id);
+        return r; }
+    void    free (CRef r) { wasted_ += (*this)[r].words(); }
+
+    Clause&       operator [] (CRef r)       { return *(Clause*)&mem[r]; }
+    const Clause& operator [] (CRef r) const { return *(const Clause*)&mem[r]; }
+
+    // Copy clause 'r' to 'to' (once) and update 'r' to its new reference.
+    void    reloc(CRef& r, ClauseAllocator& to) {
+        Clause& c = (*this)[r];
+        if (c.reloced()) { r = c.relocation(); return; }
+        uint n = c.words();
+        to.capacity(to.sz + n);
+        CRef nr = to.sz;
+        to.sz += n;
+        for (uint i = 0; i < n; i++) to.mem[nr + i] = mem[r + i];
+        c.relocate(nr);
+        r = nr; }
+
+    void    moveTo(ClauseAllocator& to) {
+        xfree(to.mem);
+        to.mem = mem; to.sz = sz; to.cap = cap; to.wasted_ = wasted_;
+        mem = NULL; sz = cap = wasted_ = 0; }
 };
 
-inline Clause* Clause_new(bool learnt, const vec<Lit>& ps, ClauseId id = ClauseId_NULL) {
-    assert(sizeof(Lit)      == sizeof(uint));
-    assert(sizeof(float)    == sizeof(uint));
-    assert(sizeof(ClauseId) == sizeof(uint));
-    void*   mem = xmalloc<char>(sizeof(Clause) + sizeof(uint)*(ps.size() + (int)learnt + (int)(id != ClauseId_NULL)));
-    return new (mem) Clause(learnt, ps, id); }
+
+//=================================================================================================
+// Watcher -- an entry of a watch list:
+
+
+// A watched clause together with one of its other literals. If that 'blocker' is true, the clause
+// is satisfied and propagation need not look at it. In the binary watch lists the blocker is the
+// other literal of the clause, so the clause is only read when it becomes a reason or a conflict.
+struct Watcher {
+    CRef    cref;
+    Lit     blocker;
+    Watcher() : cref(CRef_Undef) {}
+    Watcher(CRef c, Lit p) : cref(c), blocker(p) {}
+};
 
 
 //=================================================================================================
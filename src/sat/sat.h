@@ -15,11 +15,20 @@
 
 using namespace std;
 
+// Result of SatSolver::assumpSolve(). UNSAT is 0, so the old
+// "if (!s.assumpSolve())" still reads "proved".
+enum SatResult
+{
+   UNSAT     = 0,
+   SAT       = 1,
+   UNDECIDED = 2     // the budget ran out first
+};
+
 /********** MiniSAT_Solver **********/
 class SatSolver
 {
    public : 
-      SatSolver():_solver(0) { }
+      SatSolver():_solver(0), _confBudget(-1), _propBudget(-1) { }
       ~SatSolver() { if (_solver) delete _solver; }
 
       // Solver initialization and reset
@@ -36,6 +45,7 @@ class SatSolver
       // Constructing proof model
       // Return the Var ID of the new Var
       inline Var newVar() { _solver->newVar(); return _curVar++; }
+      inline Var nVars() const { return _curVar; }
       // fa/fb = true if it is inverted
       void addAigCNF(Var vf, Var va, bool fa, Var vb, bool fb) {
          vec<Lit> lits;
@@ -65,18 +75,67 @@ class SatSolver
          _solver->addClause(lits); lits.clear();
       }
 
+      // vf = AND of the literals "ins": a clause per input and one wide
+      // clause; a repeated input is dropped, complementary ones give vf = 0
+      void addAndCNF(Var vf, const vec<Lit>& ins) {
+         vec<Lit> lits;
+         Lit lf = Lit(vf);
+         for (int i = 0; i < ins.size(); ++i) {
+            lits.push(ins[i]); lits.push(~lf);
+            _solver->addClause(lits); lits.clear();
+         }
+         for (int i = 0; i < ins.size(); ++i) lits.push(~ins[i]);
+         lits.push(lf);
+         _solver->addClause(lits);
+      }
+      // vf = vs? vt: ve; fs/ft/fe = true if it is inverted
+      // (an XOR is a MUX with ve = ~vt)
+      void addMuxCNF(Var vf, Var vs, bool fs, Var vt, bool ft, Var ve, bool fe) {
+         vec<Lit> lits;
+         Lit lf = Lit(vf);
+         Lit ls = fs? ~Lit(vs): Lit(vs);
+         Lit lt = ft? ~Lit(vt): Lit(vt);
+         Lit le = fe? ~Lit(ve): Lit(ve);
+         lits.push(~ls); lits.push(~lt); lits.push( lf);
+         _solver->addClause(lits); lits.clear();
+         lits.push(~ls); lits.push( lt); lits.push(~lf);
+         _solver->addClause(lits); lits.clear();
+         lits.push( ls); lits.push(~le); lits.push( lf);
+         _solver->addClause(lits); lits.clear();
+         lits.push( ls); lits.push( le); lits.push(~lf);
+         _solver->addClause(lits); lits.clear();
+      }
+
+      // Only decision variables are branched on. A variable that is not,
+      // and is not implied by them, is unknown (-1) in the model.
+      void setDecision(Var v, bool d) { _solver->setDecisionVar(v, d); }
+
       // For incremental proof, use "assumeSolve()"
       void assumeRelease() { _assump.clear(); }
       void assumeProperty(Var prop, bool val) {
          _assump.push(val? Lit(prop): ~Lit(prop));
       }
-      bool assumpSolve() { return _solver->solve(_assump); }
+      // Each call may use at most "conf" conflicts and "prop" propagations;
+      // a negative budget means no limit
+      void setBudget(int64 conf, int64 prop = -1) {
+         _confBudget = conf; _propBudget = prop;
+      }
+      SatResult assumpSolve() {
+         _solver->setConfBudget(_confBudget);
+         _solver->setPropBudget(_propBudget);
+         lbool r = _solver->solveLimited(_assump);
+         return r == l_True? SAT: (r == l_False? UNSAT: UNDECIDED);
+      }
+
+      // After SAT: "lits" (true in the model) become the least literals of
+      // a model under the same assumptions, false before true, lits[0] first
+      void assumpLexMin(vec<Lit>& lits) { _solver->lexMin(_assump, lits); }
 
       // For one time proof, use "solve"
       void assertProperty(Var prop, bool val) {
          _solver->addUnit(val? Lit(prop): ~Lit(prop));
       }
-      bool solve() { _solver->solve(); return _solver->okay(); }
+      bool solve() { _solver->budgetOff(); _solver->solve(); return _solver->okay(); }
 
       // Functions about Reporting
       // Return 1/0/-1; -1 means unknown value
@@ -89,6 +148,8 @@ class SatSolver
       Solver           *_solver;    // Pointer to a Minisat solver
       Var               _curVar;    // Variable currently
       vec<Lit>          _assump;    // Assumption List for assumption solve
+      int64             _confBudget;   // per assumpSolve(), < 0 if none
+      int64             _propBudget;
 };
 
 #endif  // SAT_H
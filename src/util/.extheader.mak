@@ -1,4 +1,4 @@
-util.d: ../../include/util.h ../../include/rnGen.h ../../include/myUsage.h ../../include/myHashSet.h ../../include/myHashMap.h 
+util.d: ../../include/util.h ../../include/rnGen.h ../../include/myUsage.h ../../include/myHashSet.h ../../include/myHashMap.h ../../include/myThreadPool.h 
 ../../include/util.h: util.h
 	@rm -f ../../include/util.h
 	@ln -fs ../src/util/util.h ../../include/util.h
@@ -14,3 +14,6 @@ util.d: ../../include/util.h ../../include/rnGen.h ../../include/myUsage.h ../..
 ../../include/myHashMap.h: myHashMap.h
 	@rm -f ../../include/myHashMap.h
 	@ln -fs ../src/util/myHashMap.h ../../include/myHashMap.h
+../../include/myThreadPool.h: myThreadPool.h
+	@rm -f ../../include/myThreadPool.h
+	@ln -fs ../src/util/myThreadPool.h ../../include/myThreadPool.h
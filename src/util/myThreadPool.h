@@ -0,0 +1,100 @@
+/****************************************************************************
+  FileName     [ myThreadPool.h ]
+  PackageName  [ util ]
+  Synopsis     [ Define a fork-join thread pool ]
+  Author       [ Chung-Yang (Ric) Huang ]
+  Copyright    [ Copyleft(c) 2008-present LaDs(III), GIEE, NTU, Taiwan ]
+****************************************************************************/
+
+#ifndef MY_THREAD_POOL_H
+#define MY_THREAD_POOL_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <condition_variable>
+
+using namespace std;
+
+//------------------------
+// Define ThreadPool class
+//------------------------
+// A pool of "size() - 1" worker threads that live as long as the pool.
+// "run(n, f)" calls f(0) ... f(n-1), spread over the workers and the
+// calling thread, and returns when all the calls are done.
+// Which thread executes which index is not specified, so "f" should only
+// write to data owned by its index.
+//
+class ThreadPool
+{
+public:
+   ThreadPool(size_t n = 1)
+   : _job(0), _numJobs(0), _next(0), _busy(0), _gen(0), _stop(false) { init(n); }
+   ~ThreadPool() { reset(); }
+
+   size_t size() const { return _workers.size() + 1; }
+
+   void init(size_t n) {
+      reset();
+      _stop = false;
+      for (size_t i = 1; i < n; ++i)
+         _workers.push_back(thread(&ThreadPool::workerLoop, this));
+   }
+   void reset() {
+      { lock_guard<mutex> l(_mtx); _stop = true; }
+      _wake.notify_all();
+      for (size_t i = 0; i < _workers.size(); ++i) _workers[i].join();
+      _workers.clear();
+   }
+
+   void run(size_t n, const function<void(size_t)>& f) {
+      if (_workers.empty() || n <= 1) {
+         for (size_t i = 0; i < n; ++i) f(i);
+         return;
+      }
+      {
+         lock_guard<mutex> l(_mtx);
+         _job = &f; _numJobs = n; _next = 0; _busy = _workers.size();
+         ++_gen;
+      }
+      _wake.notify_all();
+      work();
+      unique_lock<mutex> l(_mtx);
+      _done.wait(l, [this] { return _busy == 0; });
+      _job = 0;
+   }
+
+private:
+   vector<thread>                      _workers;
+   mutex                               _mtx;
+   condition_variable                  _wake;
+   condition_variable                  _done;
+   const function<void(size_t)>*       _job;
+   size_t                              _numJobs;
+   atomic<size_t>                      _next;
+   size_t                              _busy;    // workers still in "run"
+   size_t                              _gen;     // ++ for every "run"
+   bool                                _stop;
+
+   void work() {
+      for (size_t i; (i = _next++) < _numJobs; ) (*_job)(i);
+   }
+   void workerLoop() {
+      size_t seen = 0;
+      while (true) {
+         {
+            unique_lock<mutex> l(_mtx);
+            _wake.wait(l, [&] { return _stop || _gen != seen; });
+            if (_stop) return;
+            seen = _gen;
+         }
+         work();
+         lock_guard<mutex> l(_mtx);
+         if (--_busy == 0) _done.notify_one();
+      }
+   }
+};
+
+#endif // MY_THREAD_POOL_H